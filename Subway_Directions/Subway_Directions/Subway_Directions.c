@@ -7,11 +7,23 @@
 * 4. 역/호선 추가
 * 5. 호선 삭제
 * 6. 역 삭제
+* 7. 탐색 엔진 선택 (선형 탐색 / 이진 힙 / radix 힙)
+* 8. 탐색 방식 선택 (전체 탐색 / 도착역 확정 시 종료 / 양방향 / CH / ALT)
+* 9. 여러 역 사이 시간/거리/요금 표 (화면 또는 CSV 파일)
+* 10. 일괄 길찾기 (요청 CSV를 모든 코어로 풀어 결과 CSV로)
+* 11. 호선 운행 중지/재개
+* 12. 호선별 역 목록
+* 13. 구간 통제 (운행 중단 / 서행, 이번 실행 동안만)
+* 14. 경로 캐시 (같은 출발/도착/모드 질의는 다시 풀지 않고 저장된 경로를 씀)
+* 15. 허브 역 (큰 환승역에서 출발하는 질의는 미리 구한 최단 경로 트리로 바로 답함)
 * 0. 프로그램 종료
+* 실행 인자로 노선도 CSV 대신 CSV 디렉터리나 목록 파일을 주면 여러 파일을 나눠 읽어 합칩니다.
+* 추가/삭제는 노선도 파일을 다시 쓰지 않고 변경 기록(노선도.journal)에 덧붙이고, 시작할 때 다시 적용합니다.
 * 추가로 새벽 1시부터 5시 사이에 프로그램을 실행하면 작동 되지 않고
 * 현재 시간을 알려주고 지하철 운행시간이 아님을 알려주었습니다.
 *
 * 최단경로알고리즘으로는 Dijkstar를 사용하였습니다
+* (우선순위 큐는 이진 힙 또는 radix 힙 중에서 고를 수 있습니다)
 */
 
 #include <stdio.h>
@@ -21,12 +33,46 @@
 #include <ctype.h>
 #include <time.h>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <iconv.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HAVE_SSE2 1
+#endif
+
 #pragma warning(disable : 4996)
 
 #define MAX_STATION_NAME 100
-#define MAX_STATIONS 1000
 #define TRANSFER_PENALTY 3
 
+// 길찾기 탐색 엔진 (메뉴 7에서 선택)
+#define ENGINE_LINEAR 0      // 기존 방식: 매번 전체 역을 훑어 최솟값 선택 O(V^2)
+#define ENGINE_BINARY_HEAP 1 // 인덱스 이진 힙 + decrease-key O((V+E)logV)
+#define ENGINE_RADIX_HEAP 2  // 단조 radix 힙 (비용이 줄어들지 않는 Dijkstra 전용)
+
+// 길찾기 탐색 방식 (메뉴 8에서 선택)
+#define SEARCH_FULL_TREE 0     // 출발역에서 닿는 모든 역을 확정 (기존 방식)
+#define SEARCH_EARLY_EXIT 1    // 도착역이 확정되면 바로 종료
+#define SEARCH_BIDIRECTIONAL 2 // 출발역/도착역 양쪽에서 탐색해서 가운데서 만남 (모드 1, 2)
+#define SEARCH_CH 3            // Contraction Hierarchies 전처리 후 질의 (모드 1, 2)
+#define SEARCH_ALT 4           // 랜드마크 하한을 쓰는 A* (모드 1, 2)
+#define SEARCH_FARE 5          // 최소 요금 경로 전용 (모드 3은 선택한 방식과 상관없이 이것을 씀)
+#define SEARCH_HUB_TREE 6      // 허브 역에서 미리 구한 최단 경로 트리 (출발역이 허브면 선택한 방식과 상관없이 씀)
+
 // ---------------------- 구조체 정의 ----------------------
 
 typedef struct SubwayEdge {
@@ -34,16 +80,145 @@ typedef struct SubwayEdge {
     float time;
     float distance;
     int line;
+    int lineSlot;           // 호선 색인(lineEntries)의 간선 목록 안 위치
     struct SubwayEdge* next;
 } SubwayEdge;
 
 typedef struct Station {
-    char name[MAX_STATION_NAME];
+    const char* name;       // namePool 안의 문자열 (NUL로 끝남)
+    unsigned hash;          // 이름 해시 (역 이름 색인에서 strcmp 전에 먼저 비교)
     SubwayEdge* edge;
+    int deleted;            // 1이면 지운 역. 번호는 압축할 때까지 그대로 두고 이름 색인에서만 뺀다
 } Station;
 
-Station stations[MAX_STATIONS];
-int stationCount = 0;
+// 역 번호는 지워도 당기지 않는다 (지운 역은 deleted 표시만). 지운 역이 충분히 쌓이면 한 번에 압축해서 번호를 다시 매긴다
+#define STATION_COMPACT_MIN 64
+
+Station* stations = NULL;
+int stationCount = 0;      // 지운 역 포함
+int stationCapacity = 0;
+int deletedStationCount = 0;
+
+// 역 이름 저장소. 이름을 블록에 이어 붙여 두고 포인터만 나눠 준다 (블록은 옮기지 않으므로 포인터가 유지됨)
+#define NAME_BLOCK_MIN 65536
+
+typedef struct NameBlock {
+    struct NameBlock* next;
+    size_t capacity;
+    size_t used;
+    char data[];
+} NameBlock;
+
+typedef struct NamePool {
+    NameBlock* first;
+    NameBlock* current;
+} NamePool;
+
+NamePool namePool;
+
+// SubwayEdge 저장소. 간선을 블록 단위로 한꺼번에 할당하고, 지운 간선은 free 목록에 모아 재사용한다
+#define EDGE_BLOCK_MIN 1024
+
+typedef struct EdgeBlock {
+    struct EdgeBlock* next;
+    int capacity;
+    int used;
+    SubwayEdge edges[];
+} EdgeBlock;
+
+typedef struct EdgeArena {
+    EdgeBlock* first;
+    EdgeBlock* current;     // 지금 채우고 있는 블록 (뒤쪽 블록은 리셋 후 재사용 대기)
+    SubwayEdge* freeList;   // 삭제된 간선 (next로 연결)
+} EdgeArena;
+
+EdgeArena edgeArena;
+
+// 호선별 간선 색인. 호선마다 그 호선 간선의 (출발역, 간선) 목록을 들고 있어서
+// 호선 삭제, 운행 중지/재개, 호선 역 목록이 전체 간선을 훑지 않고 그 호선 간선만 본다
+typedef struct LineEdge {
+    int from;
+    SubwayEdge* edge;
+} LineEdge;
+
+typedef struct LineEntry {
+    int line;
+    int suspended;          // 1이면 운행 중지 (간선은 그대로 두고 노선 그래프에서만 뺀다)
+    int count;
+    int capacity;
+    LineEdge* edges;
+    int sequenceValid;      // 0이면 다음 역 목록 질의 때 sequence를 다시 만든다
+    int sequenceCount;
+    int* sequence;          // 호선 역 순서 (종점부터)
+    int* segmentFrom;       // 앞 역과 이어지면 -2. 아니면 새 구간의 시작: 갈래면 갈라지는 역, 끊긴 구간이면 -1
+} LineEntry;
+
+LineEntry* lineEntries = NULL;
+int lineEntryCount = 0;
+int lineEntryCapacity = 0;
+int lastLineEntry = 0;      // 마지막으로 찾은 항목 (같은 호선 간선이 연달아 들어올 때)
+int suspendedLineCount = 0;
+
+// 길찾기용 CSR 그래프. 역별 간선 연결 리스트를 역 번호 순서대로 배열에 펼친 읽기 전용 스냅샷
+// (역 u의 간선은 [offsets[u], offsets[u + 1]) 구간, 필드별로 배열을 나눠 순차 접근)
+typedef struct CsrGraph {
+    int stationCount;
+    int edgeCount;
+    int edgeCapacity;
+    int* offsets;
+    int* destIndex;
+    float* time;
+    float* distance;
+    int* line;
+    int mapped;            // 1이면 배열이 스냅샷 파일 매핑을 가리킴 (다시 만들 때 realloc 대신 새로 할당)
+} CsrGraph;
+
+CsrGraph graph;
+int edgeListsStale = 0; // 스냅샷에서 CSR만 불러왔으면 1, 편집 전에 역별 간선 리스트를 CSR에서 다시 만든다
+int graphDirty = 1;    // 간선 리스트가 바뀌면 1, 다음 길찾기 전에 CSR을 다시 만든다
+int graphVersion = 0;  // CSR을 다시 만들 때마다 1씩 증가 (CSR로 만든 다른 색인이 최신인지 확인)
+int landmarksStale = 1; // 거리가 줄어들 수 있는 편집(CSV 다시 불러오기, 호선 추가) 후 1, ALT 표를 다시 계산
+
+// 역별 환승 시간 (transfer_time.csv: 역,출발호선,도착호선,시간(분)). 호선이 0이면 모든 호선에 적용
+#define TRANSFER_FILE "transfer_time.csv"
+
+typedef struct TransferRule {
+    const char* station;  // namePool 안의 역 이름
+    int fromLine;
+    int toLine;
+    float minutes;
+} TransferRule;
+
+TransferRule* transferRules = NULL;
+int transferRuleCount = 0;
+int transferRuleCapacity = 0;
+
+// 호선별 배차 (timetable.csv: 호선,시작,끝,배차간격(분)). 시각은 HH:MM이고 새벽 시간은 24:30처럼 24시를 넘겨 적는다.
+// 끝이 비어 있거나 배차간격이 0이면 시작 시각에 열차 한 대 (열차를 하나씩 적을 때). 파일에 없는 호선은 기본 배차
+#define TIMETABLE_FILE "timetable.csv"
+#define DEFAULT_FIRST_TRAIN (5 * 3600 + 30 * 60)
+#define DEFAULT_LAST_TRAIN (24 * 3600)
+#define DEFAULT_HEADWAY (5 * 60)
+#define SERVICE_DAY_START (4 * 3600)  // 이보다 이른 시각은 전날 운행일의 24시 이후로 본다
+
+typedef struct HeadwayBand {
+    int line;
+    int from;     // 종점 출발 시각 (초)
+    int to;
+    int headway;  // 초, 0이면 from에 한 번만
+} HeadwayBand;
+
+HeadwayBand* headwayBands = NULL;
+int headwayBandCount = 0;
+int headwayBandCapacity = 0;
+int timetableLoaded = 0;   // 0이면 다음 시간표 탐색 전에 timetable.csv를 읽는다
+int timetableVersion = 0;  // 배차를 다시 읽을 때마다 1씩 증가
+
+// 역 이름 -> 역 번호 색인 (open addressing, 선형 탐사)
+int* nameIndex = NULL;      // 각 칸에 역 번호, 빈 칸은 -1
+int nameIndexCapacity = 0;  // 항상 2의 거듭제곱
+int searchEngine = ENGINE_BINARY_HEAP;
+int searchStrategy = SEARCH_EARLY_EXIT;
 
 // ---------------------- 공통 유틸 함수 ----------------------
 
@@ -57,106 +232,6127 @@ void trim(char* str) {
     if (start != str) memmove(str, start, strlen(start) + 1);
 }
 
-//역 이름으로 찾는 함수
-int getStationIndexByName(const char* name) {
-    for (int i = 0; i < stationCount; i++) {
-        if (strcmp(stations[i].name, name) == 0)
+// 노선도 CSV와 변경 기록에 그대로 적을 수 있는 역 이름인지 (따옴표를 쓰지 않으므로 ','와 줄바꿈 같은 제어 문자는 안 됨)
+int isStorableName(const char* name) {
+    if (name[0] == '\0') return 0;
+    for (const unsigned char* p = (const unsigned char*)name; *p; p++)
+        if (*p == ',' || *p < 0x20 || *p == 0x7f) return 0;
+    return 1;
+}
+
+// "HH:MM" 또는 "HH:MM:SS"를 초로 (형식이 틀리면 -1)
+int parseClock(const char* text) {
+    int hour, minute, second = 0;
+    if (sscanf(text, "%d:%d:%d", &hour, &minute, &second) < 2) return -1;
+    if (hour < 0 || minute < 0 || minute > 59 || second < 0 || second > 59) return -1;
+    return hour * 3600 + minute * 60 + second;
+}
+
+// 초를 "HH:MM"으로 (24시를 넘으면 다음 날 시각으로)
+void formatClock(int seconds, char* buffer, size_t size) {
+    int minutes = seconds / 60;
+    snprintf(buffer, size, "%02d:%02d", minutes / 60 % 24, minutes % 60);
+}
+
+// 이름 저장소에 length 바이트짜리 이름을 복사하고 NUL로 끝나는 사본을 돌려줌
+const char* internName(const char* name, size_t length) {
+    NameBlock* block = namePool.current;
+    while (block && block->capacity - block->used < length + 1) {
+        block = block->next;
+        if (block) block->used = 0;
+    }
+    if (!block) {
+        size_t capacity = NAME_BLOCK_MIN;
+        while (capacity < length + 1) capacity *= 2;
+        block = (NameBlock*)malloc(sizeof(NameBlock) + capacity);
+        block->next = NULL;
+        block->capacity = capacity;
+        block->used = 0;
+        if (namePool.current) {
+            // 리셋 후 재사용하던 뒤쪽 블록이 모자라면 맨 뒤에 붙인다
+            NameBlock* last = namePool.current;
+            while (last->next) last = last->next;
+            last->next = block;
+        }
+        else namePool.first = block;
+    }
+    namePool.current = block;
+
+    char* copy = block->data + block->used;
+    memcpy(copy, name, length);
+    copy[length] = '\0';
+    block->used += length + 1;
+    return copy;
+}
+
+// 저장소 비우기 (블록은 남겨 두고 다음 불러오기에서 재사용)
+void resetNamePool() {
+    namePool.current = namePool.first;
+    if (namePool.current) namePool.current->used = 0;
+}
+
+// 역 이름 해시 (FNV-1a)
+unsigned hashNameLength(const char* name, size_t length) {
+    unsigned h = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        h ^= (unsigned char)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// 색인에 역 번호 하나 넣기 (빈 칸이 나올 때까지 선형 탐사)
+void nameIndexPut(int index) {
+    unsigned mask = nameIndexCapacity - 1;
+    unsigned slot = stations[index].hash & mask;
+    while (nameIndex[slot] != -1) slot = (slot + 1) & mask;
+    nameIndex[slot] = index;
+}
+
+// 색인을 현재 stations[]로 다시 만듦. 사용률이 절반을 넘지 않도록 크기를 잡는다
+void rebuildNameIndex() {
+    int capacity = 64;
+    while (capacity < stationCount * 2) capacity *= 2;
+    if (capacity != nameIndexCapacity) {
+        free(nameIndex);
+        nameIndex = (int*)malloc(sizeof(int) * capacity);
+        nameIndexCapacity = capacity;
+    }
+    for (int i = 0; i < nameIndexCapacity; i++) nameIndex[i] = -1;
+    for (int i = 0; i < stationCount; i++)
+        if (!stations[i].deleted) nameIndexPut(i);
+}
+
+// 색인에서 역 번호 하나 빼기. 뒤쪽 칸 중 빈 칸을 건너뛰어야 찾을 수 있는 것들을 당겨서 탐사가 끊기지 않게 한다
+void nameIndexRemove(int index) {
+    unsigned mask = nameIndexCapacity - 1;
+    unsigned hole = stations[index].hash & mask;
+    while (nameIndex[hole] != index) {
+        if (nameIndex[hole] == -1) return;
+        hole = (hole + 1) & mask;
+    }
+    for (unsigned next = (hole + 1) & mask; nameIndex[next] != -1; next = (next + 1) & mask) {
+        unsigned home = stations[nameIndex[next]].hash & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            nameIndex[hole] = nameIndex[next];
+            hole = next;
+        }
+    }
+    nameIndex[hole] = -1;
+}
+
+unsigned hashBytes(unsigned h, const void* data, size_t size) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// 길이를 아는 이름(NUL로 끝나지 않아도 됨)으로 역 찾기
+int findStation(const char* name, size_t length, unsigned h) {
+    if (nameIndexCapacity == 0) return -1;
+    unsigned mask = nameIndexCapacity - 1;
+    for (unsigned slot = h & mask; nameIndex[slot] != -1; slot = (slot + 1) & mask) {
+        int i = nameIndex[slot];
+        if (stations[i].hash == h && strncmp(stations[i].name, name, length) == 0 && stations[i].name[length] == '\0')
             return i;
     }
     return -1;
 }
 
+//역 이름으로 찾는 함수
+int getStationIndexByName(const char* name) {
+    size_t length = strlen(name);
+    return findStation(name, length, hashNameLength(name, length));
+}
+
+// 이름으로 역을 찾고, 없으면 이름을 저장소에 복사해 새 역을 만들고 색인에 등록
+int internStation(const char* name, size_t length) {
+    unsigned h = hashNameLength(name, length);
+    int index = findStation(name, length, h);
+    if (index != -1) return index;
+
+    if (stationCount == stationCapacity) {
+        stationCapacity = stationCapacity ? stationCapacity * 2 : 256;
+        stations = (Station*)realloc(stations, sizeof(Station) * stationCapacity);
+    }
+    memset(&stations[stationCount], 0, sizeof(Station));
+    stations[stationCount].name = internName(name, length);
+    stations[stationCount].hash = h;
+    index = stationCount++;
+
+    if (stationCount * 2 > nameIndexCapacity) rebuildNameIndex();
+    else nameIndexPut(index);
+    return index;
+}
+
+int getOrAddStation(const char* name) {
+    return internStation(name, strlen(name));
+}
+
+// ---------------------- 간선 저장소 ----------------------
+
+// 간선 하나 할당. free 목록 -> 현재 블록 -> 다음 블록 순서로 찾고, 없을 때만 새 블록을 만든다
+SubwayEdge* allocEdge() {
+    if (edgeArena.freeList) {
+        SubwayEdge* edge = edgeArena.freeList;
+        edgeArena.freeList = edge->next;
+        return edge;
+    }
+
+    EdgeBlock* block = edgeArena.current;
+    if (!block || block->used == block->capacity) {
+        if (block && block->next) {
+            block = block->next;
+            block->used = 0;
+        }
+        else {
+            // 블록 크기를 두 배씩 늘려서 큰 노선도도 할당 몇 번으로 끝나게 한다
+            int capacity = block ? block->capacity * 2 : EDGE_BLOCK_MIN;
+            EdgeBlock* fresh = (EdgeBlock*)malloc(sizeof(EdgeBlock) + sizeof(SubwayEdge) * capacity);
+            fresh->next = NULL;
+            fresh->capacity = capacity;
+            fresh->used = 0;
+            if (block) block->next = fresh;
+            else edgeArena.first = fresh;
+            block = fresh;
+        }
+        edgeArena.current = block;
+    }
+    return &block->edges[block->used++];
+}
+
+// 간선 하나 반납 (free 목록 앞에 붙임)
+void freeEdge(SubwayEdge* edge) {
+    edge->next = edgeArena.freeList;
+    edgeArena.freeList = edge;
+}
+
+// 연결 리스트 전체를 free 목록에 이어 붙임
+void freeEdgeList(SubwayEdge* head) {
+    if (!head) return;
+    SubwayEdge* tail = head;
+    while (tail->next) tail = tail->next;
+    tail->next = edgeArena.freeList;
+    edgeArena.freeList = head;
+}
+
+// 모든 간선을 한 번에 버림. 블록은 그대로 두고 처음부터 다시 채운다
+void resetEdgeArena() {
+    edgeArena.current = edgeArena.first;
+    if (edgeArena.current) edgeArena.current->used = 0;
+    edgeArena.freeList = NULL;
+}
+
+// 호선 번호로 색인 항목 찾기. create면 없을 때 새로 만듦
+LineEntry* findLineEntry(int line, int create) {
+    if (lastLineEntry < lineEntryCount && lineEntries[lastLineEntry].line == line) return &lineEntries[lastLineEntry];
+    for (int i = 0; i < lineEntryCount; i++) {
+        if (lineEntries[i].line == line) {
+            lastLineEntry = i;
+            return &lineEntries[i];
+        }
+    }
+    if (!create) return NULL;
+    if (lineEntryCount == lineEntryCapacity) {
+        lineEntryCapacity = lineEntryCapacity ? lineEntryCapacity * 2 : 16;
+        lineEntries = (LineEntry*)realloc(lineEntries, sizeof(LineEntry) * lineEntryCapacity);
+    }
+    LineEntry* entry = &lineEntries[lineEntryCount];
+    memset(entry, 0, sizeof(LineEntry));
+    entry->line = line;
+    lastLineEntry = lineEntryCount++;
+    return entry;
+}
+
+void lineIndexAdd(int from, SubwayEdge* edge) {
+    LineEntry* entry = findLineEntry(edge->line, 1);
+    if (entry->count == entry->capacity) {
+        entry->capacity = entry->capacity ? entry->capacity * 2 : 64;
+        entry->edges = (LineEdge*)realloc(entry->edges, sizeof(LineEdge) * entry->capacity);
+    }
+    edge->lineSlot = entry->count;
+    entry->edges[entry->count].from = from;
+    entry->edges[entry->count].edge = edge;
+    entry->count++;
+    entry->sequenceValid = 0;
+}
+
+// 간선 하나를 색인에서 뺌 (마지막 간선을 그 자리로 옮김)
+void lineIndexRemove(SubwayEdge* edge) {
+    LineEntry* entry = findLineEntry(edge->line, 0);
+    if (!entry) return;
+    int slot = edge->lineSlot;
+    entry->edges[slot] = entry->edges[--entry->count];
+    entry->edges[slot].edge->lineSlot = slot;
+    entry->sequenceValid = 0;
+}
+
+// 간선 목록만 비움 (keepSuspended가 0이면 운행 중지 표시도 지움)
+void clearLineIndex(int keepSuspended) {
+    for (int i = 0; i < lineEntryCount; i++) {
+        lineEntries[i].count = 0;
+        lineEntries[i].sequenceValid = 0;
+        if (!keepSuspended) lineEntries[i].suspended = 0;
+    }
+    if (!keepSuspended) suspendedLineCount = 0;
+}
+
+// 노선 그래프를 만들 때 뺄 호선인지
+int lineSuspended(int line) {
+    if (suspendedLineCount == 0) return 0;
+    LineEntry* entry = findLineEntry(line, 0);
+    return entry && entry->suspended;
+}
+
+// 스냅샷으로 불러온 CSR에서 역별 간선 리스트를 만듦 (CSR은 리스트 순서를 그대로 담고 있으므로 거꾸로 넣으면 같은 순서)
+void ensureEdgeLists() {
+    if (!edgeListsStale) return;
+    edgeListsStale = 0;
+    clearLineIndex(1);
+    for (int i = 0; i < graph.stationCount; i++) {
+        stations[i].edge = NULL;
+        for (int k = graph.offsets[i + 1] - 1; k >= graph.offsets[i]; k--) {
+            SubwayEdge* edge = allocEdge();
+            edge->destIndex = graph.destIndex[k];
+            edge->time = graph.time[k];
+            edge->distance = graph.distance[k];
+            edge->line = graph.line[k];
+            edge->next = stations[i].edge;
+            stations[i].edge = edge;
+            lineIndexAdd(i, edge);
+        }
+    }
+}
+
 // 간선 추가 
 void addEdge(int from, int to, float time, float distance, int line) {
-    SubwayEdge* edge = (SubwayEdge*)malloc(sizeof(SubwayEdge));
+    ensureEdgeLists();
+    SubwayEdge* edge = allocEdge();
     edge->destIndex = to;
     edge->time = time;
     edge->distance = distance;
     edge->line = line;
     edge->next = stations[from].edge;
     stations[from].edge = edge;
+    lineIndexAdd(from, edge);
+    graphDirty = 1;
+}
+
+// 요금표: 기본 운임에 구간마다 추가 운임을 더한다. 거리는 미터 단위 정수로 계산하고,
+// 구간 시작을 넘은 거리는 km 단위로 버린 뒤 stepMeters마다 stepFare씩 더한다
+#define FARE_BASE 1400
+
+typedef struct FareBand {
+    int fromMeters;
+    int stepMeters;
+    int stepFare;
+} FareBand;
+
+FareBand fareBands[] = {
+    { 10000, 5000, 100 },
+};
+#define FARE_BAND_COUNT (int)(sizeof(fareBands) / sizeof(fareBands[0]))
+
+int fareForMeters(int meters) {
+    int fare = FARE_BASE;
+    for (int i = 0; i < FARE_BAND_COUNT && meters > fareBands[i].fromMeters; i++) {
+        int end = meters;
+        if (i + 1 < FARE_BAND_COUNT && end > fareBands[i + 1].fromMeters) end = fareBands[i + 1].fromMeters;
+        int extra = (end - fareBands[i].fromMeters) / 1000 * 1000;
+        fare += (extra + fareBands[i].stepMeters - 1) / fareBands[i].stepMeters * fareBands[i].stepFare;
+    }
+    return fare;
+}
+
+// 같은 요금으로 갈 수 있는 가장 먼 거리 (meters가 속한 요금 구간의 끝)
+int fareBracketLimit(int meters) {
+    int fare = fareForMeters(meters);
+    int low = meters, step = 1;
+    while (step < (1 << 28) && fareForMeters(low + step) == fare) {
+        low += step;
+        step *= 2;
+    }
+    if (step >= (1 << 28)) return INT_MAX / 2;  // 더 이상 요금이 오르지 않음
+    int high = low + step;                       // fareForMeters(high) > fare
+    while (high - low > 1) {
+        int mid = low + (high - low) / 2;
+        if (fareForMeters(mid) == fare) low = mid;
+        else high = mid;
+    }
+    return low;
+}
+
+int kmToMeters(float km) {
+    return (int)(km * 1000.0f + 0.5f);
+}
+
+// 요금 계산 함수
+int calculateFare(float distance) {
+    return fareForMeters(kmToMeters(distance));
+}
+
+// ---------------------- CSR 그래프 ----------------------
+
+// 연결 리스트 순서를 그대로 유지해서 펼침 (같은 비용일 때 고르는 간선이 기존과 같도록)
+void buildGraph() {
+    ensureEdgeLists();
+    if (graph.mapped) {
+        // 스냅샷 매핑은 읽기 전용이므로 새 배열을 할당
+        graph.offsets = NULL;
+        graph.destIndex = NULL;
+        graph.time = NULL;
+        graph.distance = NULL;
+        graph.line = NULL;
+        graph.edgeCapacity = 0;
+        graph.mapped = 0;
+    }
+    int edgeCount = 0;
+    for (int i = 0; i < stationCount; i++)
+        for (SubwayEdge* e = stations[i].edge; e; e = e->next) edgeCount++;
+
+    graph.offsets = (int*)realloc(graph.offsets, sizeof(int) * (stationCount + 1));
+    if (edgeCount > graph.edgeCapacity) {
+        graph.edgeCapacity = edgeCount;
+        graph.destIndex = (int*)realloc(graph.destIndex, sizeof(int) * edgeCount);
+        graph.time = (float*)realloc(graph.time, sizeof(float) * edgeCount);
+        graph.distance = (float*)realloc(graph.distance, sizeof(float) * edgeCount);
+        graph.line = (int*)realloc(graph.line, sizeof(int) * edgeCount);
+    }
+
+    int k = 0;
+    for (int i = 0; i < stationCount; i++) {
+        graph.offsets[i] = k;
+        for (SubwayEdge* e = stations[i].edge; e; e = e->next) {
+            graph.destIndex[k] = e->destIndex;
+            graph.time[k] = e->time;
+            graph.distance[k] = e->distance;
+            graph.line[k] = e->line;
+            k++;
+        }
+    }
+    graph.offsets[stationCount] = k;
+    graph.stationCount = stationCount;
+    graph.edgeCount = edgeCount;
+    graphDirty = 0;
+    graphVersion++;
+}
+
+// 편집 이후 처음 길찾기할 때 한 번만 다시 만든다
+void ensureGraph() {
+    if (graphDirty || graph.stationCount != stationCount) buildGraph();
+}
+
+// ---------------------- 노선 그래프 (역, 호선) ----------------------
+
+// 환승 비용을 정확히 계산하려고 역을 (역, 호선) 노드로 펼친 그래프. 모든 탐색 방식이 이 그래프에서 돈다.
+// 노드 번호: [0, routeNodeCount)는 (역, 호선) 노드, 그 뒤로 역마다 출발 노드와 도착 노드가 하나씩 있다.
+// 간선: 같은 호선 운행 / 같은 역 다른 호선 환승(transfer_time.csv, 없으면 TRANSFER_PENALTY) /
+//       출발 노드 -> 승차 / 하차 -> 도착 노드
+#define ROUTE_RIDE 0
+#define ROUTE_TRANSFER 1
+#define ROUTE_BOARD 2
+#define ROUTE_ALIGHT 3
+
+typedef struct RouteGraph {
+    int version;          // 만들 때의 graphVersion
+    int metric;           // 비용에 반영한 구간 통제의 metricVersion
+    unsigned fingerprint; // 노선 그래프 내용 해시 (저장된 CH 파일이 같은 그래프용인지 확인)
+    int stationCount;
+    int routeNodeCount;
+    int nodeCount;
+    int edgeCount;
+    int* stationFirst;    // 역 s의 (역, 호선) 노드는 [stationFirst[s], stationFirst[s + 1])
+    int* nodeStation;
+    int* nodeLine;        // 출발/도착 노드는 0
+    int* offsets;
+    int* target;
+    float* weightTime;    // 모드 1 비용 (구간 통제 반영)
+    float* weightDist;    // 모드 2 비용 (구간 통제 반영)
+    float* baseTime;      // 통제 전 원래 비용
+    float* baseDist;
+    float* km;            // 실제 이동 거리 (환승/승하차 간선은 0)
+    int* meters;          // km를 미터 단위 정수로 (요금 계산용)
+    char* kind;           // ROUTE_RIDE / ROUTE_TRANSFER / ROUTE_BOARD / ROUTE_ALIGHT
+    int* rOffsets;        // 역방향 CSR: 노드로 들어오는 간선은 [rOffsets[v], rOffsets[v + 1])
+    int* rSource;
+    int* rEdge;           // 정방향 간선 번호 (비용은 정방향 배열에서 읽음)
+    int* transferHead;    // 역마다 환승 규칙 목록 (transferRules 번호, -1: 끝)
+    int* transferNext;
+} RouteGraph;
+
+RouteGraph routeGraph;
+
+int departNode(int station) {
+    return routeGraph.routeNodeCount + station;
+}
+
+int arriveNode(int station) {
+    return routeGraph.routeNodeCount + routeGraph.stationCount + station;
+}
+
+// 역 s에서 호선 line 노드 번호 (역마다 호선이 몇 개 안 되므로 선형 탐색)
+int routeNodeOf(int station, int line) {
+    for (int n = routeGraph.stationFirst[station]; n < routeGraph.stationFirst[station + 1]; n++)
+        if (routeGraph.nodeLine[n] == line) return n;
+    return -1;
+}
+
+void addRouteEdge(int* k, int to, float time, float distWeight, float km, int kind) {
+    if (routeGraph.target) {
+        routeGraph.target[*k] = to;
+        routeGraph.weightTime[*k] = time;
+        routeGraph.weightDist[*k] = distWeight;
+        routeGraph.km[*k] = km;
+        routeGraph.kind[*k] = (char)kind;
+    }
+    (*k)++;
+}
+
+// 역 s에서 fromLine -> toLine 환승 시간. 더 구체적인 규칙이 우선이고, 규칙이 없으면 TRANSFER_PENALTY
+float transferTime(int s, int fromLine, int toLine) {
+    float minutes = TRANSFER_PENALTY;
+    int bestScore = -1;
+    for (int r = routeGraph.transferHead[s]; r != -1; r = routeGraph.transferNext[r]) {
+        const TransferRule* rule = &transferRules[r];
+        if (rule->fromLine != 0 && rule->fromLine != fromLine) continue;
+        if (rule->toLine != 0 && rule->toLine != toLine) continue;
+        int score = (rule->fromLine != 0) + (rule->toLine != 0);
+        if (score > bestScore) {
+            bestScore = score;
+            minutes = rule->minutes;
+        }
+    }
+    return minutes;
+}
+
+// 한 노드의 간선을 채움 (routeGraph.target이 NULL이면 개수만 셈)
+void emitRouteEdges(int node, int* k) {
+    int V = routeGraph.stationCount;
+    int R = routeGraph.routeNodeCount;
+    if (node < R) {
+        int s = routeGraph.nodeStation[node];
+        int line = routeGraph.nodeLine[node];
+        for (int e = graph.offsets[s]; e < graph.offsets[s + 1]; e++) {
+            if (graph.line[e] != line) continue;
+            addRouteEdge(k, routeNodeOf(graph.destIndex[e], line), graph.time[e], graph.distance[e], graph.distance[e], ROUTE_RIDE);
+        }
+        for (int n = routeGraph.stationFirst[s]; n < routeGraph.stationFirst[s + 1]; n++) {
+            if (n == node) continue;
+            float minutes = routeGraph.target ? transferTime(s, line, routeGraph.nodeLine[n]) : 0.0f;
+            addRouteEdge(k, n, minutes, minutes, 0.0f, ROUTE_TRANSFER);
+        }
+        addRouteEdge(k, arriveNode(s), 0.0f, 0.0f, 0.0f, ROUTE_ALIGHT);
+    }
+    else if (node < R + V) {
+        int s = node - R;
+        for (int n = routeGraph.stationFirst[s]; n < routeGraph.stationFirst[s + 1]; n++)
+            addRouteEdge(k, n, 0.0f, 0.0f, 0.0f, ROUTE_BOARD);
+    }
+}
+
+// 구간 통제: 노선도 파일을 고치지 않고 운행 구간을 잠시 막거나(운행 중단) 느리게(시간 배수) 하는 덮어쓰기 목록.
+// 통제는 노선 그래프의 weightTime/weightDist만 바꾸고 원래 비용은 baseTime/baseDist에 남겨 둔다.
+// 그래프 구조와 graphVersion은 그대로고 metricVersion만 올라가므로, 전처리 색인은 다시 만들지 않고
+// 비용만 다시 채운다 (CH는 지름길 비용 재계산, 시간표는 정류장 시각 재계산, ALT는 하한을 줄여서 그대로 사용)
+#define CLOSED_WEIGHT INT_MAX  // 막힌 간선의 비용 (어떤 경로 비용보다도 크다)
+
+typedef struct Disruption {
+    int from;       // 역 번호 (from < to, 양방향에 적용)
+    int to;
+    int line;
+    int closed;     // 1이면 운행 중단
+    float factor;   // 운행 중단이 아니면 시간 배수
+} Disruption;
+
+Disruption* disruptions = NULL;
+int disruptionCount = 0;
+int disruptionCapacity = 0;
+int metricVersion = 0;          // 통제를 바꿀 때마다 1씩 증가
+float disruptionTimeScale = 1.0f; // 통제 중 가장 작은 시간 배수 (1 이하). ALT 시간 하한에 곱한다
+
+int routeEdgeClosed(const RouteGraph* g, int k) {
+    return g->weightDist[k] >= CLOSED_WEIGHT;
+}
+
+// 노선 그래프에서 from -> to 구간의 운행 간선 하나에 통제를 적용 (없으면 원래 비용)
+void applySegment(int from, int to, int line, const Disruption* d) {
+    int u = routeNodeOf(from, line), v = routeNodeOf(to, line);
+    if (u == -1 || v == -1) return;
+    for (int k = routeGraph.offsets[u]; k < routeGraph.offsets[u + 1]; k++) {
+        if (routeGraph.target[k] != v || routeGraph.kind[k] != ROUTE_RIDE) continue;
+        routeGraph.weightTime[k] = routeGraph.baseTime[k];
+        routeGraph.weightDist[k] = routeGraph.baseDist[k];
+        if (!d) continue;
+        if (d->closed) {
+            routeGraph.weightTime[k] = CLOSED_WEIGHT;
+            routeGraph.weightDist[k] = CLOSED_WEIGHT;
+        }
+        else {
+            routeGraph.weightTime[k] = routeGraph.baseTime[k] * d->factor;
+        }
+    }
+}
+
+void applyDisruption(int from, int to, int line, const Disruption* d) {
+    applySegment(from, to, line, d);
+    applySegment(to, from, line, d);
+}
+
+// 비용을 원래대로 돌리고 통제를 모두 다시 적용
+void applyDisruptions() {
+    memcpy(routeGraph.weightTime, routeGraph.baseTime, sizeof(float) * routeGraph.edgeCount);
+    memcpy(routeGraph.weightDist, routeGraph.baseDist, sizeof(float) * routeGraph.edgeCount);
+    for (int i = 0; i < disruptionCount; i++)
+        applyDisruption(disruptions[i].from, disruptions[i].to, disruptions[i].line, &disruptions[i]);
+    routeGraph.metric = metricVersion;
+}
+
+int findDisruption(int from, int to, int line) {
+    if (from > to) { int t = from; from = to; to = t; }
+    for (int i = 0; i < disruptionCount; i++)
+        if (disruptions[i].from == from && disruptions[i].to == to && disruptions[i].line == line) return i;
+    return -1;
+}
+
+void updateDisruptionScale() {
+    disruptionTimeScale = 1.0f;
+    for (int i = 0; i < disruptionCount; i++)
+        if (!disruptions[i].closed && disruptions[i].factor < disruptionTimeScale) disruptionTimeScale = disruptions[i].factor;
+}
+
+// 통제 목록이 바뀐 뒤. 노선 그래프가 최신이면 그 구간만 고치고, 아니면 다시 만들 때 전부 적용된다
+void disruptionChanged(int from, int to, int line) {
+    metricVersion++;
+    updateDisruptionScale();
+    if (routeGraph.offsets == NULL || routeGraph.version != graphVersion || routeGraph.metric != metricVersion - 1) return;
+    int i = findDisruption(from, to, line);
+    applyDisruption(from, to, line, i == -1 ? NULL : &disruptions[i]);
+    routeGraph.metric = metricVersion;
+}
+
+// 구간 통제 추가/변경. closed가 0이면 시간에 factor를 곱한다. 그 호선으로 바로 이어진 구간이 없으면 0
+int setDisruption(int from, int to, int line, int closed, float factor) {
+    ensureGraph();
+    int found = 0;
+    for (int k = graph.offsets[from]; k < graph.offsets[from + 1] && !found; k++)
+        found = graph.destIndex[k] == to && graph.line[k] == line;
+    for (int k = graph.offsets[to]; k < graph.offsets[to + 1] && !found; k++)
+        found = graph.destIndex[k] == from && graph.line[k] == line;
+    if (!found) return 0;
+
+    int i = findDisruption(from, to, line);
+    if (i == -1) {
+        if (disruptionCount == disruptionCapacity) {
+            disruptionCapacity = disruptionCapacity ? disruptionCapacity * 2 : 8;
+            disruptions = (Disruption*)realloc(disruptions, sizeof(Disruption) * disruptionCapacity);
+        }
+        i = disruptionCount++;
+    }
+    Disruption d = { from < to ? from : to, from < to ? to : from, line, closed, factor };
+    disruptions[i] = d;
+    disruptionChanged(from, to, line);
+    return 1;
+}
+
+// 구간 통제 해제. 통제 중이 아니었으면 0
+int clearDisruption(int from, int to, int line) {
+    int i = findDisruption(from, to, line);
+    if (i == -1) return 0;
+    disruptions[i] = disruptions[--disruptionCount];
+    disruptionChanged(from, to, line);
+    return 1;
+}
+
+// station(-1이면 모든 역)이나 line(-1이면 모든 호선)에 걸린 통제를 지움 (역/호선 삭제, 노선도 다시 불러오기)
+void dropDisruptions(int station, int line) {
+    int kept = 0;
+    for (int i = 0; i < disruptionCount; i++) {
+        const Disruption* d = &disruptions[i];
+        int hit = (station == -1 || d->from == station || d->to == station) && (line == -1 || d->line == line);
+        if (!hit) disruptions[kept++] = *d;
+    }
+    if (kept == disruptionCount) return;
+    disruptionCount = kept;
+    metricVersion++;
+    updateDisruptionScale();
+}
+
+void buildRouteGraph() {
+    ensureGraph();
+    int V = stationCount;
+
+    // 역마다 지나는 호선 목록 (CSR에 나온 순서, 중복 제거)
+    routeGraph.stationFirst = (int*)realloc(routeGraph.stationFirst, sizeof(int) * (V + 1));
+    routeGraph.nodeStation = (int*)realloc(routeGraph.nodeStation, sizeof(int) * (graph.edgeCount + 2 * V));
+    routeGraph.nodeLine = (int*)realloc(routeGraph.nodeLine, sizeof(int) * (graph.edgeCount + 2 * V));
+    int R = 0;
+    for (int s = 0; s < V; s++) {
+        routeGraph.stationFirst[s] = R;
+        for (int e = graph.offsets[s]; e < graph.offsets[s + 1]; e++) {
+            if (lineSuspended(graph.line[e])) continue;  // 운행 중지 호선은 노드를 만들지 않으므로 운행 간선도 생기지 않는다
+            int known = 0;
+            for (int n = routeGraph.stationFirst[s]; n < R; n++)
+                if (routeGraph.nodeLine[n] == graph.line[e]) { known = 1; break; }
+            if (known) continue;
+            routeGraph.nodeStation[R] = s;
+            routeGraph.nodeLine[R] = graph.line[e];
+            R++;
+        }
+    }
+    routeGraph.stationFirst[V] = R;
+    for (int s = 0; s < V; s++) {
+        routeGraph.nodeStation[R + s] = s;
+        routeGraph.nodeLine[R + s] = 0;
+        routeGraph.nodeStation[R + V + s] = s;
+        routeGraph.nodeLine[R + V + s] = 0;
+    }
+    routeGraph.stationCount = V;
+    routeGraph.routeNodeCount = R;
+    routeGraph.nodeCount = R + 2 * V;
+
+    // 환승 규칙을 역 번호별 목록으로 묶음
+    routeGraph.transferHead = (int*)realloc(routeGraph.transferHead, sizeof(int) * (V ? V : 1));
+    routeGraph.transferNext = (int*)realloc(routeGraph.transferNext, sizeof(int) * (transferRuleCount ? transferRuleCount : 1));
+    for (int s = 0; s < V; s++) routeGraph.transferHead[s] = -1;
+    for (int r = 0; r < transferRuleCount; r++) {
+        int s = getStationIndexByName(transferRules[r].station);
+        if (s == -1) continue;
+        routeGraph.transferNext[r] = routeGraph.transferHead[s];
+        routeGraph.transferHead[s] = r;
+    }
+
+    // 한 번은 개수만 세고, 배열을 잡은 다음 다시 돌면서 채운다
+    int N = routeGraph.nodeCount;
+    free(routeGraph.target);
+    routeGraph.target = NULL;
+    int m = 0;
+    for (int n = 0; n < N; n++) emitRouteEdges(n, &m);
+
+    routeGraph.offsets = (int*)realloc(routeGraph.offsets, sizeof(int) * (N + 1));
+    routeGraph.target = (int*)malloc(sizeof(int) * (m ? m : 1));
+    routeGraph.weightTime = (float*)realloc(routeGraph.weightTime, sizeof(float) * (m ? m : 1));
+    routeGraph.weightDist = (float*)realloc(routeGraph.weightDist, sizeof(float) * (m ? m : 1));
+    routeGraph.km = (float*)realloc(routeGraph.km, sizeof(float) * (m ? m : 1));
+    routeGraph.meters = (int*)realloc(routeGraph.meters, sizeof(int) * (m ? m : 1));
+    routeGraph.kind = (char*)realloc(routeGraph.kind, sizeof(char) * (m ? m : 1));
+    int k = 0;
+    for (int n = 0; n < N; n++) {
+        routeGraph.offsets[n] = k;
+        emitRouteEdges(n, &k);
+    }
+    routeGraph.offsets[N] = k;
+    routeGraph.edgeCount = k;
+    for (int e = 0; e < k; e++) routeGraph.meters[e] = kmToMeters(routeGraph.km[e]);
+
+    // 도착 쪽에서 거꾸로 탐색할 때 쓰는 역방향 CSR
+    routeGraph.rOffsets = (int*)realloc(routeGraph.rOffsets, sizeof(int) * (N + 1));
+    routeGraph.rSource = (int*)realloc(routeGraph.rSource, sizeof(int) * (k ? k : 1));
+    routeGraph.rEdge = (int*)realloc(routeGraph.rEdge, sizeof(int) * (k ? k : 1));
+    memset(routeGraph.rOffsets, 0, sizeof(int) * (N + 1));
+    for (int e = 0; e < k; e++) routeGraph.rOffsets[routeGraph.target[e] + 1]++;
+    for (int v = 0; v < N; v++) routeGraph.rOffsets[v + 1] += routeGraph.rOffsets[v];
+    for (int u = 0; u < N; u++) {
+        for (int e = routeGraph.offsets[u]; e < routeGraph.offsets[u + 1]; e++) {
+            int slot = routeGraph.rOffsets[routeGraph.target[e]]++;
+            routeGraph.rSource[slot] = u;
+            routeGraph.rEdge[slot] = e;
+        }
+    }
+    for (int v = N; v > 0; v--) routeGraph.rOffsets[v] = routeGraph.rOffsets[v - 1];
+    routeGraph.rOffsets[0] = 0;
+
+    unsigned h = 2166136261u;
+    h = hashBytes(h, &N, sizeof(N));
+    h = hashBytes(h, &R, sizeof(R));
+    h = hashBytes(h, routeGraph.nodeLine, sizeof(int) * N);
+    h = hashBytes(h, routeGraph.offsets, sizeof(int) * (N + 1));
+    h = hashBytes(h, routeGraph.target, sizeof(int) * k);
+    h = hashBytes(h, routeGraph.weightTime, sizeof(float) * k);
+    h = hashBytes(h, routeGraph.weightDist, sizeof(float) * k);
+    h = hashBytes(h, routeGraph.kind, sizeof(char) * k);
+    routeGraph.fingerprint = h;
+    routeGraph.version = graphVersion;
+
+    // 해시는 원래 비용으로 구하고 (저장된 CH 파일은 통제와 상관없이 쓸 수 있음), 그다음 통제를 적용한다
+    routeGraph.baseTime = (float*)realloc(routeGraph.baseTime, sizeof(float) * (k ? k : 1));
+    routeGraph.baseDist = (float*)realloc(routeGraph.baseDist, sizeof(float) * (k ? k : 1));
+    memcpy(routeGraph.baseTime, routeGraph.weightTime, sizeof(float) * k);
+    memcpy(routeGraph.baseDist, routeGraph.weightDist, sizeof(float) * k);
+    applyDisruptions();
+}
+
+void ensureRouteGraph() {
+    ensureGraph();
+    if (routeGraph.offsets == NULL || routeGraph.version != graphVersion) buildRouteGraph();
+    else if (routeGraph.metric != metricVersion) applyDisruptions();
+}
+
+float routeWeight(int k, int mode) {
+    return (mode == 1) ? routeGraph.weightTime[k] : routeGraph.weightDist[k];
+}
+
+// ---------------------- 파일 매핑 ----------------------
+
+// 파일 전체를 읽기 전용으로 메모리에 매핑 (복사 없이 페이지 캐시를 그대로 읽음)
+typedef struct MappedFile {
+    const char* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+} MappedFile;
+
+int mapFile(MappedFile* mf, const char* filename) {
+    memset(mf, 0, sizeof(MappedFile));
+#ifdef _WIN32
+    mf->file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (mf->file == INVALID_HANDLE_VALUE) return 0;
+    LARGE_INTEGER size;
+    GetFileSizeEx(mf->file, &size);
+    mf->size = (size_t)size.QuadPart;
+    if (mf->size == 0) return 1;  // 빈 파일은 매핑할 수 없으므로 data 없이 성공
+    mf->mapping = CreateFileMappingA(mf->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mf->mapping) mf->data = (const char*)MapViewOfFile(mf->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!mf->data) {
+        if (mf->mapping) CloseHandle(mf->mapping);
+        CloseHandle(mf->file);
+        return 0;
+    }
+#else
+    mf->fd = open(filename, O_RDONLY);
+    if (mf->fd < 0) return 0;
+    struct stat st;
+    fstat(mf->fd, &st);
+    mf->size = (size_t)st.st_size;
+    if (mf->size == 0) return 1;
+    void* data = mmap(NULL, mf->size, PROT_READ, MAP_PRIVATE, mf->fd, 0);
+    if (data == MAP_FAILED) {
+        close(mf->fd);
+        return 0;
+    }
+    madvise(data, mf->size, MADV_SEQUENTIAL);
+    mf->data = (const char*)data;
+#endif
+    return 1;
+}
+
+void unmapFile(MappedFile* mf) {
+#ifdef _WIN32
+    if (mf->data) UnmapViewOfFile(mf->data);
+    if (mf->mapping) CloseHandle(mf->mapping);
+    CloseHandle(mf->file);
+#else
+    if (mf->data) munmap((void*)mf->data, mf->size);
+    close(mf->fd);
+#endif
+    mf->data = NULL;
+}
+
+// 쓴 내용을 디스크까지 내려보냄
+int syncFile(FILE* file) {
+    if (fflush(file) != 0) return 0;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+// 다 쓴 임시 파일로 target을 한 번에 바꿔치기 (중간에 죽어도 예전 파일이나 새 파일 중 하나는 남는다).
+// POSIX rename은 원래 있던 target을 원자적으로 덮어쓰므로 먼저 지우지 않는다
+int replaceFile(const char* tempName, const char* target) {
+#ifdef _WIN32
+    return MoveFileExA(tempName, target, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(tempName, target) == 0;
+#endif
+}
+
+// ---------------------- 문자 인코딩 ----------------------
+
+// 역 이름은 메모리에서 항상 UTF-8로 가진다. CSV는 UTF-8(BOM 있어도 됨) 또는 CP949(EUC-KR 포함)를 받고,
+// 콘솔 입력도 UTF-8이 아니면 CP949로 보고 바꾼다. 쓸 때는 파일이 원래 쓰던 인코딩으로 되돌린다
+#define ENCODING_UTF8 0
+#define ENCODING_CP949 1
+
+// 앞에서부터 ASCII(0x80 미만)가 몇 바이트 이어지는지. SSE2가 있으면 16바이트씩, 없으면 8바이트씩 본다
+size_t asciiPrefix(const char* data, size_t size) {
+    size_t i = 0;
+#ifdef HAVE_SSE2
+    while (i + 16 <= size) {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(data + i)));
+        if (mask) break;
+        i += 16;
+    }
+#endif
+    while (i + 8 <= size) {
+        unsigned long long word;
+        memcpy(&word, data + i, 8);
+        if (word & 0x8080808080808080ull) break;
+        i += 8;
+    }
+    while (i < size && (unsigned char)data[i] < 0x80) i++;
+    return i;
+}
+
+// 올바른 UTF-8인지 (overlong, 서로게이트, U+10FFFF 초과는 틀린 것으로 봄)
+int isValidUtf8(const char* data, size_t size) {
+    const unsigned char* p = (const unsigned char*)data;
+    size_t i = 0;
+    while (i < size) {
+        i += asciiPrefix(data + i, size - i);
+        if (i >= size) break;
+        unsigned char c = p[i];
+        int extra;
+        unsigned min;
+        unsigned code;
+        if (c >= 0xC2 && c <= 0xDF) { extra = 1; min = 0x80; code = c & 0x1F; }
+        else if (c >= 0xE0 && c <= 0xEF) { extra = 2; min = 0x800; code = c & 0x0F; }
+        else if (c >= 0xF0 && c <= 0xF4) { extra = 3; min = 0x10000; code = c & 0x07; }
+        else return 0;
+        if (i + extra >= size) return 0;
+        for (int k = 1; k <= extra; k++) {
+            if ((p[i + k] & 0xC0) != 0x80) return 0;
+            code = (code << 6) | (p[i + k] & 0x3F);
+        }
+        if (code < min || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF)) return 0;
+        i += extra + 1;
+    }
+    return 1;
+}
+
+// 파일 내용의 인코딩. UTF-8 BOM은 건너뛰도록 data/size를 옮긴다
+int detectEncoding(const char** data, size_t* size) {
+    if (*size >= 3 && memcmp(*data, "\xEF\xBB\xBF", 3) == 0) {
+        *data += 3;
+        *size -= 3;
+        return ENCODING_UTF8;
+    }
+    return isValidUtf8(*data, *size) ? ENCODING_UTF8 : ENCODING_CP949;
+}
+
+// 파일 하나의 인코딩 (없거나 비어 있으면 UTF-8)
+int fileEncoding(const char* filename) {
+    MappedFile mf;
+    if (!mapFile(&mf, filename)) return ENCODING_UTF8;
+    const char* data = mf.data;
+    size_t size = mf.size;
+    int encoding = size ? detectEncoding(&data, &size) : ENCODING_UTF8;
+    unmapFile(&mf);
+    return encoding;
+}
+
+// 인코딩 변환기. 파일 하나를 읽는 동안 열어 두고 이름마다 다시 쓴다 (스레드마다 따로)
+typedef struct Transcoder {
+    int from;
+    int to;
+#ifndef _WIN32
+    iconv_t cd;
+#endif
+} Transcoder;
+
+int openTranscoder(Transcoder* t, int from, int to) {
+    t->from = from;
+    t->to = to;
+#ifndef _WIN32
+    t->cd = iconv_open(to == ENCODING_UTF8 ? "UTF-8" : "CP949", from == ENCODING_UTF8 ? "UTF-8" : "CP949");
+    if (t->cd == (iconv_t)-1) return 0;
+#endif
+    return 1;
+}
+
+void closeTranscoder(Transcoder* t) {
+#ifndef _WIN32
+    if (t->cd != (iconv_t)-1) iconv_close(t->cd);
+#endif
+}
+
+// length 바이트를 변환해서 out에 NUL로 끝나게 씀 (outSize를 넘는 뒷부분은 버림). 쓴 바이트 수를 돌려줌.
+// 변환할 수 없는 바이트는 '?'로 바꾼다
+size_t transcodeWith(Transcoder* t, const char* in, size_t length, char* out, size_t outSize) {
+    if (outSize == 0) return 0;
+    size_t written = 0;
+#ifdef _WIN32
+    wchar_t local[256];
+    wchar_t* wide = length < 256 ? local : (wchar_t*)malloc(sizeof(wchar_t) * (length + 1));
+    int fromPage = t->from == ENCODING_UTF8 ? CP_UTF8 : 949;
+    int toPage = t->to == ENCODING_UTF8 ? CP_UTF8 : 949;
+    int wideLength = length ? MultiByteToWideChar(fromPage, 0, in, (int)length, wide, (int)length + 1) : 0;
+    // 출력 버퍼가 모자라면 WideCharToMultiByte가 통째로 실패하므로, 먼저 길이를 재서 들어가는 글자까지만 변환한다
+    // (iconv 쪽처럼 글자 경계에서 자름)
+    int room = (int)outSize - 1;
+    int need = wideLength ? WideCharToMultiByte(toPage, 0, wide, wideLength, NULL, 0, NULL, NULL) : 0;
+    if (need > room) {
+        int keep = (int)((long long)wideLength * room / need);  // 글자마다 바이트 수가 비슷하다고 보고 어림한 뒤 맞춤
+        while (keep < wideLength && WideCharToMultiByte(toPage, 0, wide, keep + 1, NULL, 0, NULL, NULL) <= room) keep++;
+        while (keep > 0 && WideCharToMultiByte(toPage, 0, wide, keep, NULL, 0, NULL, NULL) > room) keep--;
+        if (keep > 0 && wide[keep - 1] >= 0xD800 && wide[keep - 1] <= 0xDBFF) keep--;  // 서로게이트 쌍은 나누지 않음
+        wideLength = keep;
+    }
+    int n = wideLength ? WideCharToMultiByte(toPage, 0, wide, wideLength, out, room, NULL, NULL) : 0;
+    written = n > 0 ? (size_t)n : 0;
+    if (wide != local) free(wide);
+#else
+    char* src = (char*)in;
+    size_t srcLeft = length;
+    char* dst = out;
+    size_t dstLeft = outSize - 1;
+    iconv(t->cd, NULL, NULL, NULL, NULL);
+    while (srcLeft > 0 && dstLeft > 0) {
+        if (iconv(t->cd, &src, &srcLeft, &dst, &dstLeft) != (size_t)-1) break;
+        if (errno == E2BIG) break;
+        *dst++ = '?';  // 잘못되거나 잘린 바이트
+        dstLeft--;
+        src++;
+        srcLeft--;
+    }
+    written = (size_t)(dst - out);
+#endif
+    out[written] = '\0';
+    return written;
+}
+
+// 한 번만 변환할 때 (콘솔 입력, CSV 한 줄 쓰기)
+size_t transcode(int from, int to, const char* in, size_t length, char* out, size_t outSize) {
+    size_t ascii = asciiPrefix(in, length);
+    if (from == to || ascii == length) {
+        size_t n = length < outSize - 1 ? length : outSize - 1;
+        memcpy(out, in, n);
+        out[n] = '\0';
+        return n;
+    }
+    Transcoder t;
+    if (!openTranscoder(&t, from, to)) {
+        out[0] = '\0';
+        return 0;
+    }
+    size_t n = transcodeWith(&t, in, length, out, outSize);
+    closeTranscoder(&t);
+    return n;
+}
+
+// 콘솔에서 읽은 이름을 UTF-8로 (이미 UTF-8이면 그대로)
+void normalizeInput(char* buffer, size_t size) {
+    size_t length = strlen(buffer);
+    if (isValidUtf8(buffer, length)) return;
+    char converted[MAX_STATION_NAME * 2];
+    transcode(ENCODING_CP949, ENCODING_UTF8, buffer, length, converted, sizeof(converted));
+    strncpy(buffer, converted, size - 1);
+    buffer[size - 1] = '\0';
+}
+
+// ---------------------- 스레드 ----------------------
+
+// 작업 스레드 최소 기능 (Windows 스레드 / pthread)
+#define MAX_WORKERS 64
+
+typedef struct WorkerThread {
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+    void (*run)(void*);
+    void* arg;
+} WorkerThread;
+
+#ifdef _WIN32
+DWORD WINAPI workerEntry(LPVOID param) {
+    WorkerThread* t = (WorkerThread*)param;
+    t->run(t->arg);
+    return 0;
+}
+#else
+void* workerEntry(void* param) {
+    WorkerThread* t = (WorkerThread*)param;
+    t->run(t->arg);
+    return NULL;
+}
+#endif
+
+int startThread(WorkerThread* t, void (*run)(void*), void* arg) {
+    t->run = run;
+    t->arg = arg;
+#ifdef _WIN32
+    t->handle = CreateThread(NULL, 0, workerEntry, t, 0, NULL);
+    return t->handle != NULL;
+#else
+    return pthread_create(&t->handle, NULL, workerEntry, t) == 0;
+#endif
+}
+
+void joinThread(WorkerThread* t) {
+#ifdef _WIN32
+    WaitForSingleObject(t->handle, INFINITE);
+    CloseHandle(t->handle);
+#else
+    pthread_join(t->handle, NULL);
+#endif
+}
+
+// 코어 수 (작업 스레드 수 기본값)
+int processorCount() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int count = (int)info.dwNumberOfProcessors;
+#else
+    int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (count < 1) count = 1;
+    return count > MAX_WORKERS ? MAX_WORKERS : count;
+}
+
+// 여러 스레드가 같이 쓰는 카운터를 amount만큼 올리고 올리기 전 값을 돌려줌
+long atomicAdd(volatile long* value, long amount) {
+#ifdef _WIN32
+    return InterlockedExchangeAdd(value, amount);
+#else
+    return __atomic_fetch_add(value, amount, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// value가 expected면 desired로 바꿈. 바꾸기 전 값을 돌려줌
+long atomicCompareExchange(volatile long* value, long expected, long desired) {
+#ifdef _WIN32
+    return InterlockedCompareExchange(value, desired, expected);
+#else
+    __atomic_compare_exchange_n(value, &expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return expected;
+#endif
+}
+
+// 아주 짧은 구간만 잡는 잠금 (0으로 두면 풀린 상태라 따로 초기화할 필요가 없음)
+void lockSpin(volatile long* lock) {
+    while (atomicCompareExchange(lock, 0, 1) != 0) {
+#ifdef _WIN32
+        SwitchToThread();
+#else
+        sched_yield();
+#endif
+    }
+}
+
+void unlockSpin(volatile long* lock) {
+    atomicCompareExchange(lock, 1, 0);
+}
+
+// count개의 작업 스레드로 run(arg)을 동시에 돌리고 모두 끝날 때까지 기다림.
+// 스레드를 만들지 못하면 그 몫은 호출한 스레드가 직접 돈다 (run은 작업을 나눠 가지는 루프여야 함)
+void runWorkers(int count, void (*run)(void*), void* arg) {
+    WorkerThread threads[MAX_WORKERS];
+    int started = 0;
+    if (count > MAX_WORKERS) count = MAX_WORKERS;
+    for (int i = 1; i < count; i++)
+        if (startThread(&threads[started], run, arg)) started++;
+    run(arg);
+    for (int i = 0; i < started; i++) joinThread(&threads[i]);
+}
+
+// ---------------------- CSV 불러오기 ----------------------
+
+// 매핑한 CSV를 제자리에서 읽는 스캐너. 필드는 원본을 가리키는 (포인터, 길이)로 돌려준다
+#define CSV_MAX_FIELDS 8
+
+typedef struct CsvField {
+    const char* text;
+    size_t length;
+} CsvField;
+
+typedef struct CsvScanner {
+    const char* cur;
+    const char* end;
+} CsvScanner;
+
+// 한 줄을 쉼표로 나눠 fields에 채우고 필드 수를 돌려줌 (앞뒤 공백 제거, 남은 줄이 없으면 -1).
+// CSV_MAX_FIELDS를 넘는 필드는 버린다
+int csvReadRow(CsvScanner* sc, CsvField* fields) {
+    if (sc->cur >= sc->end) return -1;
+    int count = 0;
+    const char* p = sc->cur;
+    while (1) {
+        const char* start = p;
+        while (p < sc->end && *p != ',' && *p != '\n') p++;
+        const char* stop = p;
+        while (start < stop && isspace((unsigned char)*start)) start++;
+        while (stop > start && isspace((unsigned char)stop[-1])) stop--;  // '\r'도 여기서 빠짐
+        if (count < CSV_MAX_FIELDS) {
+            fields[count].text = start;
+            fields[count].length = (size_t)(stop - start);
+            count++;
+        }
+        if (p >= sc->end || *p == '\n') break;
+        p++;  // ','
+    }
+    sc->cur = (p < sc->end) ? p + 1 : p;
+    return count;
+}
+
+int csvInt(const CsvField* f) {
+    const char* p = f->text;
+    const char* end = p + f->length;
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+    int value = 0;
+    while (p < end && *p >= '0' && *p <= '9') value = value * 10 + (*p++ - '0');
+    return negative ? -value : value;
+}
+
+// 소수 읽기. 정수부와 소수부를 하나의 정수로 모은 뒤 10의 거듭제곱으로 한 번만 나눈다.
+// 자릿수가 너무 많거나 지수 표기면 strtod로 넘긴다
+float csvFloat(const CsvField* f) {
+    static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+        1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+    const char* p = f->text;
+    const char* end = p + f->length;
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+
+    unsigned long long mantissa = 0;
+    int digits = 0, fraction = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        mantissa = mantissa * 10 + (*p++ - '0');
+        digits++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            mantissa = mantissa * 10 + (*p++ - '0');
+            digits++;
+            fraction++;
+        }
+    }
+    if (p < end || digits > 18) {
+        char buffer[64];
+        size_t length = f->length < sizeof(buffer) - 1 ? f->length : sizeof(buffer) - 1;
+        memcpy(buffer, f->text, length);
+        buffer[length] = '\0';
+        return (float)strtod(buffer, NULL);
+    }
+    double value = (double)mantissa / powers[fraction];
+    return (float)(negative ? -value : value);
+}
+
+// csvFloat로 다시 읽었을 때 value와 똑같아지는 가장 짧은 표기 (0.9는 "0.9", 0.125는 "0.125")
+const char* formatCsvFloat(char* buffer, size_t size, float value) {
+    for (int precision = 1; precision <= 9; precision++) {
+        snprintf(buffer, size, "%.*g", precision, value);
+        CsvField field = { buffer, strlen(buffer) };
+        if (csvFloat(&field) == value) break;
+    }
+    return buffer;
+}
+
+// 시각 필드 (HH:MM) -> 초
+int csvClock(const CsvField* f) {
+    char buffer[32];
+    size_t length = f->length < sizeof(buffer) - 1 ? f->length : sizeof(buffer) - 1;
+    memcpy(buffer, f->text, length);
+    buffer[length] = '\0';
+    return parseClock(buffer);
+}
+
+// 환승 시간 파일 불러오기. 파일이 없으면 모든 환승에 TRANSFER_PENALTY를 쓴다
+void loadTransferTimes(const char* filename) {
+    transferRuleCount = 0;
+    MappedFile mf;
+    if (!mapFile(&mf, filename)) return;
+
+    const char* data = mf.data;
+    size_t size = mf.size;
+    int encoding = detectEncoding(&data, &size);
+    CsvScanner sc = { data, data + size };
+    CsvField fields[CSV_MAX_FIELDS];
+    csvReadRow(&sc, fields);  // 머리글
+
+    int count;
+    while ((count = csvReadRow(&sc, fields)) != -1) {
+        if (count < 4 || fields[0].length == 0) continue;
+
+        if (transferRuleCount == transferRuleCapacity) {
+            transferRuleCapacity = transferRuleCapacity ? transferRuleCapacity * 2 : 64;
+            transferRules = (TransferRule*)realloc(transferRules, sizeof(TransferRule) * transferRuleCapacity);
+        }
+        TransferRule* rule = &transferRules[transferRuleCount++];
+        char name[MAX_STATION_NAME * 2];
+        size_t length = transcode(encoding, ENCODING_UTF8, fields[0].text, fields[0].length, name, sizeof(name));
+        rule->station = internName(name, length);
+        rule->fromLine = csvInt(&fields[1]);
+        rule->toLine = csvInt(&fields[2]);
+        rule->minutes = csvFloat(&fields[3]);
+    }
+
+    unmapFile(&mf);
+    printf("환승 시간 %d건을 불러왔습니다.\n", transferRuleCount);
+}
+
+// 배차 파일 불러오기. 파일이 없으면 모든 호선이 기본 배차
+void loadTimetable(const char* filename) {
+    headwayBandCount = 0;
+    timetableLoaded = 1;
+    timetableVersion++;
+    MappedFile mf;
+    if (!mapFile(&mf, filename)) return;
+
+    const char* data = mf.data;
+    size_t size = mf.size;
+    detectEncoding(&data, &size);
+    CsvScanner sc = { data, data + size };
+    CsvField fields[CSV_MAX_FIELDS];
+    csvReadRow(&sc, fields);  // 머리글
+
+    int count;
+    while ((count = csvReadRow(&sc, fields)) != -1) {
+        if (count < 2 || fields[0].length == 0) continue;
+        int from = csvClock(&fields[1]), to = from, headway = 0;
+        if (count >= 4 && fields[2].length > 0) {
+            to = csvClock(&fields[2]);
+            headway = (int)(csvFloat(&fields[3]) * 60.0f + 0.5f);
+        }
+        if (from < 0 || to < from) continue;
+
+        if (headwayBandCount == headwayBandCapacity) {
+            headwayBandCapacity = headwayBandCapacity ? headwayBandCapacity * 2 : 32;
+            headwayBands = (HeadwayBand*)realloc(headwayBands, sizeof(HeadwayBand) * headwayBandCapacity);
+        }
+        HeadwayBand* band = &headwayBands[headwayBandCount++];
+        band->line = csvInt(&fields[0]);
+        band->from = from;
+        band->to = to;
+        band->headway = headway;
+    }
+
+    unmapFile(&mf);
+    printf("배차 %d건을 불러왔습니다.\n", headwayBandCount);
+}
+
+// 노선도 CSV 한 개를 읽은 결과. 역 이름은 파일 안에서만 쓰는 번호(처음 나온 순서)로 바꿔 두고,
+// 이름 자체는 매핑된 파일을 그대로 가리킨다 (합칠 때까지 매핑을 유지)
+typedef struct ParsedEdge {
+    int from;
+    int to;
+    int line;
+    float time;
+    float distance;
+} ParsedEdge;
+
+typedef struct ParsedFile {
+    const char* filename;
+    MappedFile mf;
+    int ok;
+    int transcodeFailed; // CP949 이름을 UTF-8로 바꿀 변환기를 열지 못함 (ok도 0)
+    int encoding;        // ENCODING_UTF8 / ENCODING_CP949
+    char* text;          // CP949 파일의 이름을 UTF-8로 바꿔 담은 곳 (names가 가리킴)
+    CsvField* names;
+    unsigned* hashes;
+    int nameCount;
+    int nameCapacity;
+    int* index;          // 파일 안 이름 색인 (open addressing, -1: 빈 칸)
+    int indexCapacity;
+    ParsedEdge* edges;
+    int edgeCount;
+    int edgeCapacity;
+} ParsedFile;
+
+// 파일 안 이름 번호. 처음 보는 이름이면 새 번호를 붙인다
+int parsedNameId(ParsedFile* pf, const CsvField* name) {
+    unsigned h = hashNameLength(name->text, name->length);
+    if (pf->nameCount * 2 >= pf->indexCapacity) {
+        int capacity = pf->indexCapacity ? pf->indexCapacity * 2 : 256;
+        free(pf->index);
+        pf->index = (int*)malloc(sizeof(int) * capacity);
+        pf->indexCapacity = capacity;
+        for (int i = 0; i < capacity; i++) pf->index[i] = -1;
+        for (int n = 0; n < pf->nameCount; n++) {
+            unsigned slot = pf->hashes[n] & (capacity - 1);
+            while (pf->index[slot] != -1) slot = (slot + 1) & (capacity - 1);
+            pf->index[slot] = n;
+        }
+    }
+    unsigned mask = pf->indexCapacity - 1;
+    unsigned slot = h & mask;
+    for (; pf->index[slot] != -1; slot = (slot + 1) & mask) {
+        int n = pf->index[slot];
+        if (pf->hashes[n] == h && pf->names[n].length == name->length && memcmp(pf->names[n].text, name->text, name->length) == 0)
+            return n;
+    }
+    if (pf->nameCount == pf->nameCapacity) {
+        pf->nameCapacity = pf->nameCapacity ? pf->nameCapacity * 2 : 256;
+        pf->names = (CsvField*)realloc(pf->names, sizeof(CsvField) * pf->nameCapacity);
+        pf->hashes = (unsigned*)realloc(pf->hashes, sizeof(unsigned) * pf->nameCapacity);
+    }
+    pf->names[pf->nameCount] = *name;
+    pf->hashes[pf->nameCount] = h;
+    pf->index[slot] = pf->nameCount;
+    return pf->nameCount++;
+}
+
+// CP949 파일에서 읽은 이름들을 UTF-8로 바꿈. 같은 이름은 이미 하나로 묶였으므로 이름마다 한 번만 변환하고,
+// ASCII 이름은 그대로 둔다
+int convertParsedNames(ParsedFile* pf) {
+    size_t capacity = 0;
+    for (int n = 0; n < pf->nameCount; n++) capacity += pf->names[n].length * 2 + 1;
+    pf->text = (char*)malloc(capacity ? capacity : 1);
+
+    Transcoder t;
+    if (!openTranscoder(&t, ENCODING_CP949, ENCODING_UTF8)) return 0;
+    size_t used = 0;
+    for (int n = 0; n < pf->nameCount; n++) {
+        CsvField* name = &pf->names[n];
+        if (asciiPrefix(name->text, name->length) == name->length) continue;
+        size_t length = transcodeWith(&t, name->text, name->length, pf->text + used, name->length * 2 + 1);
+        name->text = pf->text + used;
+        name->length = length;
+        used += length + 1;
+    }
+    closeTranscoder(&t);
+    return 1;
+}
+
+// 파일 하나를 매핑해서 간선 목록으로 읽음 (전역 상태를 건드리지 않으므로 여러 스레드에서 동시에 불러도 됨)
+void parseNetworkFile(ParsedFile* pf) {
+    pf->ok = mapFile(&pf->mf, pf->filename);
+    if (!pf->ok) return;
+
+    const char* data = pf->mf.data;
+    size_t size = pf->mf.size;
+    pf->encoding = detectEncoding(&data, &size);
+    CsvScanner sc = { data, data + size };
+    CsvField fields[CSV_MAX_FIELDS];
+    csvReadRow(&sc, fields);  // 머리글
+
+    int count;
+    while ((count = csvReadRow(&sc, fields)) != -1) {
+        if (count < 5 || fields[1].length == 0 || fields[2].length == 0) continue;
+        if (pf->edgeCount == pf->edgeCapacity) {
+            pf->edgeCapacity = pf->edgeCapacity ? pf->edgeCapacity * 2 : 1024;
+            pf->edges = (ParsedEdge*)realloc(pf->edges, sizeof(ParsedEdge) * pf->edgeCapacity);
+        }
+        ParsedEdge* e = &pf->edges[pf->edgeCount++];
+        e->line = csvInt(&fields[0]);
+        e->from = parsedNameId(pf, &fields[1]);
+        e->to = parsedNameId(pf, &fields[2]);
+        e->distance = csvFloat(&fields[3]);
+        e->time = csvFloat(&fields[4]);
+    }
+    // 이름을 바꾸지 못하면 CP949 바이트가 UTF-8 이름으로 섞여 들어가므로 파일을 못 읽은 것으로 본다
+    if (pf->encoding == ENCODING_CP949 && !convertParsedNames(pf)) {
+        unmapFile(&pf->mf);
+        pf->ok = 0;
+        pf->transcodeFailed = 1;
+    }
+}
+
+void reportParseFailure(const ParsedFile* pf) {
+    if (pf->transcodeFailed) printf("CP949 역 이름을 UTF-8로 바꿀 수 없어 불러오지 않았습니다: %s\n", pf->filename);
+    else printf("CSV 파일을 열 수 없습니다: %s\n", pf->filename);
+}
+
+void freeParsedFile(ParsedFile* pf) {
+    if (pf->ok) unmapFile(&pf->mf);
+    free(pf->text);
+    free(pf->names);
+    free(pf->hashes);
+    free(pf->index);
+    free(pf->edges);
+}
+
+// 읽은 파일을 역 목록/간선에 합침. 파일 안 이름을 처음 나온 순서대로 등록하므로
+// 파일 순서만 같으면 스레드가 어떤 순서로 끝났든 역 번호가 항상 같다
+void mergeParsedFile(ParsedFile* pf) {
+    int* global = (int*)malloc(sizeof(int) * (pf->nameCount ? pf->nameCount : 1));
+    for (int n = 0; n < pf->nameCount; n++)
+        global[n] = internStation(pf->names[n].text, pf->names[n].length);
+    for (int i = 0; i < pf->edgeCount; i++) {
+        ParsedEdge* e = &pf->edges[i];
+        addEdge(global[e->from], global[e->to], e->time, e->distance, e->line);
+        addEdge(global[e->to], global[e->from], e->time, e->distance, e->line);
+    }
+    free(global);
+}
+
+// 스냅샷에서 불러온 노선도가 가리키던 파일 매핑을 놓음 (CSR은 다음 buildGraph에서 새로 할당)
+MappedFile snapshotFile;
+
+void releaseSnapshot() {
+    if (!snapshotFile.data) return;
+    if (graph.mapped) {
+        graph.offsets = NULL;
+        graph.destIndex = NULL;
+        graph.time = NULL;
+        graph.distance = NULL;
+        graph.line = NULL;
+        graph.edgeCapacity = 0;
+        graph.stationCount = 0;
+        graph.edgeCount = 0;
+        graph.mapped = 0;
+    }
+    unmapFile(&snapshotFile);
+}
+
+// 기존 노선도를 버리고 처음부터 다시 만들 준비
+void resetNetwork() {
+    stationCount = 0;
+    deletedStationCount = 0;
+    edgeListsStale = 0;
+    resetEdgeArena();
+    clearLineIndex(0);
+    resetNamePool();
+    rebuildNameIndex();
+    transferRuleCount = 0;
+    timetableLoaded = 0;
+    dropDisruptions(-1, -1);
+    releaseSnapshot();
+    graphDirty = 1;
+    landmarksStale = 1;
+}
+
+// 노선도 CSV 불러오기 (호선,출발역,도착역,거리(km),시간(분)). 파일을 매핑해서 한 번만 훑는다
+void loadCSV(const char* filename) {
+    ParsedFile pf;
+    memset(&pf, 0, sizeof(ParsedFile));
+    pf.filename = filename;
+    parseNetworkFile(&pf);
+    if (!pf.ok) {
+        reportParseFailure(&pf);
+        freeParsedFile(&pf);
+        return;
+    }
+
+    resetNetwork();
+    mergeParsedFile(&pf);
+    freeParsedFile(&pf);
+    loadTransferTimes(TRANSFER_FILE);
+    buildGraph();
+    printf("총 %d개의 역을 불러왔습니다.\n", stationCount);
+}
+
+// 여러 파일을 나눠 읽는 작업 목록. 스레드마다 다음 파일 번호를 하나씩 가져간다
+typedef struct ParseJobs {
+    ParsedFile* files;
+    int count;
+    volatile long next;
+} ParseJobs;
+
+void parseJobsWorker(void* arg) {
+    ParseJobs* jobs = (ParseJobs*)arg;
+    while (1) {
+        long i = atomicAdd(&jobs->next, 1);
+        if (i >= jobs->count) break;
+        parseNetworkFile(&jobs->files[i]);
+    }
+}
+
+int compareFileNames(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+void addFileName(char*** names, int* count, int* capacity, const char* dir, const char* name, size_t length) {
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 16;
+        *names = (char**)realloc(*names, sizeof(char*) * *capacity);
+    }
+    size_t dirLength = dir ? strlen(dir) : 0;
+    char* path = (char*)malloc(dirLength + length + 2);
+    if (dirLength) {
+        memcpy(path, dir, dirLength);
+        path[dirLength++] = '/';
+    }
+    memcpy(path + dirLength, name, length);
+    path[dirLength + length] = '\0';
+    (*names)[(*count)++] = path;
+}
+
+int isDirectory(const char* path) {
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
+
+// 디렉터리 안의 .csv 파일 목록 (환승 시간 파일 제외, 이름순으로 정렬해서 역 번호가 실행마다 같게)
+int listNetworkDirectory(const char* dir, char*** names) {
+    int count = 0, capacity = 0;
+    *names = NULL;
+#ifdef _WIN32
+    char pattern[MAX_PATH];
+    snprintf(pattern, sizeof(pattern), "%s\\*.csv", dir);
+    WIN32_FIND_DATAA found;
+    HANDLE find = FindFirstFileA(pattern, &found);
+    if (find != INVALID_HANDLE_VALUE) {
+        do {
+            if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+            if (strcmp(found.cFileName, TRANSFER_FILE) == 0 || strcmp(found.cFileName, TIMETABLE_FILE) == 0) continue;
+            addFileName(names, &count, &capacity, dir, found.cFileName, strlen(found.cFileName));
+        } while (FindNextFileA(find, &found));
+        FindClose(find);
+    }
+#else
+    DIR* d = opendir(dir);
+    if (d) {
+        struct dirent* entry;
+        while ((entry = readdir(d)) != NULL) {
+            size_t length = strlen(entry->d_name);
+            if (length < 5 || strcmp(entry->d_name + length - 4, ".csv") != 0) continue;
+            if (strcmp(entry->d_name, TRANSFER_FILE) == 0 || strcmp(entry->d_name, TIMETABLE_FILE) == 0) continue;
+            addFileName(names, &count, &capacity, dir, entry->d_name, length);
+        }
+        closedir(d);
+    }
+#endif
+    qsort(*names, count, sizeof(char*), compareFileNames);
+    return count;
+}
+
+// 목록 파일(한 줄에 CSV 경로 하나, 빈 줄과 #으로 시작하는 줄은 무시)을 적힌 순서대로 읽음.
+// 상대 경로는 목록 파일이 있는 디렉터리 기준
+int readManifest(const char* manifest, char*** names) {
+    int count = 0, capacity = 0;
+    *names = NULL;
+    MappedFile mf;
+    if (!mapFile(&mf, manifest)) return -1;
+
+    char dir[1024] = "";
+    const char* slash = strrchr(manifest, '/');
+    const char* backslash = strrchr(manifest, '\\');
+    if (backslash > slash) slash = backslash;
+    if (slash && (size_t)(slash - manifest) < sizeof(dir)) {
+        memcpy(dir, manifest, slash - manifest);
+        dir[slash - manifest] = '\0';
+    }
+
+    CsvScanner sc = { mf.data, mf.data + mf.size };
+    CsvField fields[CSV_MAX_FIELDS];
+    while (csvReadRow(&sc, fields) != -1) {
+        if (fields[0].length == 0 || fields[0].text[0] == '#') continue;
+        int absolute = fields[0].text[0] == '/' || fields[0].text[0] == '\\' || (fields[0].length > 1 && fields[0].text[1] == ':');
+        addFileName(names, &count, &capacity, absolute ? NULL : dir, fields[0].text, fields[0].length);
+    }
+    unmapFile(&mf);
+    return count;
+}
+
+// 노선도 불러오기. path가 .csv 파일이면 그 파일 하나, 디렉터리면 안의 .csv 전부, 그 밖에는 목록 파일로 본다.
+// 여러 파일은 작업 스레드들이 나눠 읽고, 합치는 것은 파일 순서대로 한 스레드에서 한다
+void loadNetwork(const char* path) {
+    size_t length = strlen(path);
+    if (length >= 4 && strcmp(path + length - 4, ".csv") == 0) {
+        loadCSV(path);
+        return;
+    }
+
+    char** names;
+    int count = isDirectory(path) ? listNetworkDirectory(path, &names) : readManifest(path, &names);
+    if (count <= 0) {
+        printf("불러올 CSV 파일이 없습니다: %s\n", path);
+        free(names);
+        return;
+    }
+
+    ParseJobs jobs;
+    jobs.files = (ParsedFile*)calloc(count, sizeof(ParsedFile));
+    jobs.count = count;
+    jobs.next = 0;
+    for (int i = 0; i < count; i++) jobs.files[i].filename = names[i];
+    int workers = processorCount();
+    runWorkers(workers < count ? workers : count, parseJobsWorker, &jobs);
+
+    // 못 여는 파일은 건너뛰지만, 인코딩 변환이 안 되면 다른 CP949 파일도 마찬가지라 전부 그만둔다
+    int transcodeFailed = 0;
+    for (int i = 0; i < count; i++) transcodeFailed |= jobs.files[i].transcodeFailed;
+    if (transcodeFailed) {
+        for (int i = 0; i < count; i++) {
+            if (jobs.files[i].transcodeFailed) reportParseFailure(&jobs.files[i]);
+            freeParsedFile(&jobs.files[i]);
+            free(names[i]);
+        }
+        free(jobs.files);
+        free(names);
+        return;
+    }
+
+    resetNetwork();
+    int loaded = 0;
+    for (int i = 0; i < count; i++) {
+        if (jobs.files[i].ok) {
+            mergeParsedFile(&jobs.files[i]);
+            loaded++;
+        }
+        else reportParseFailure(&jobs.files[i]);
+        freeParsedFile(&jobs.files[i]);
+        free(names[i]);
+    }
+    free(jobs.files);
+    free(names);
+
+    loadTransferTimes(TRANSFER_FILE);
+    buildGraph();
+    printf("CSV 파일 %d개에서 총 %d개의 역을 불러왔습니다.\n", loaded, stationCount);
+}
+
+// ---------------------- 기능 구현 ----------------------
+
+// 지하철 전체역 출력
+void printStations() {
+    printf("\n--- 지하철 역 목록 ---\n");
+    for (int i = 0; i < stationCount; i++) {
+        if (stations[i].deleted) continue;
+        printf("%d - %s\n", i, stations[i].name);
+    }
+}
+
+// ---------------------- 우선순위 큐 ----------------------
+
+// 역 번호를 담는 최소 힙. pos[]로 힙 안의 위치를 기억해서 decrease-key를 지원
+typedef struct IndexedHeap {
+    int* heap;
+    int* pos;          // 역 번호 -> 힙 위치 (-1: 힙에 없음)
+    const float* key;  // 비교에 쓰는 비용 배열 (cost[])
+    int size;
+} IndexedHeap;
+
+// 역 capacity개를 담을 수 있게 늘림 (이미 충분하면 그대로 재사용)
+void heapReserve(IndexedHeap* h, int capacity, int oldCapacity) {
+    if (capacity <= oldCapacity) return;
+    h->heap = (int*)realloc(h->heap, sizeof(int) * capacity);
+    h->pos = (int*)realloc(h->pos, sizeof(int) * capacity);
+    for (int i = oldCapacity; i < capacity; i++) h->pos[i] = -1;
+}
+
+// 남아 있는 항목만 지워서 다음 질의에 재사용
+void heapClear(IndexedHeap* h, const float* key) {
+    for (int i = 0; i < h->size; i++) h->pos[h->heap[i]] = -1;
+    h->size = 0;
+    h->key = key;
+}
+
+// 비용이 같으면 번호가 작은 역이 먼저 나오도록 해서 선형 탐색과 같은 경로를 만든다
+int heapLess(const IndexedHeap* h, int a, int b) {
+    if (h->key[a] != h->key[b]) return h->key[a] < h->key[b];
+    return a < b;
+}
+
+void heapSwap(IndexedHeap* h, int i, int j) {
+    int a = h->heap[i], b = h->heap[j];
+    h->heap[i] = b; h->pos[b] = i;
+    h->heap[j] = a; h->pos[a] = j;
+}
+
+void heapSiftUp(IndexedHeap* h, int i) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!heapLess(h, h->heap[i], h->heap[parent])) break;
+        heapSwap(h, i, parent);
+        i = parent;
+    }
+}
+
+void heapSiftDown(IndexedHeap* h, int i) {
+    while (1) {
+        int smallest = i;
+        int l = 2 * i + 1, r = 2 * i + 2;
+        if (l < h->size && heapLess(h, h->heap[l], h->heap[smallest])) smallest = l;
+        if (r < h->size && heapLess(h, h->heap[r], h->heap[smallest])) smallest = r;
+        if (smallest == i) break;
+        heapSwap(h, i, smallest);
+        i = smallest;
+    }
+}
+
+// 새로 넣거나, 이미 있으면 줄어든 key에 맞게 위로 올림 (decrease-key)
+void heapPush(IndexedHeap* h, int v) {
+    if (h->pos[v] == -1) {
+        h->heap[h->size] = v;
+        h->pos[v] = h->size++;
+    }
+    heapSiftUp(h, h->pos[v]);
+}
+
+int heapPop(IndexedHeap* h) {
+    if (h->size == 0) return -1;
+    int top = h->heap[0];
+    heapSwap(h, 0, --h->size);
+    h->pos[top] = -1;
+    heapSiftDown(h, 0);
+    return top;
+}
+
+// 단조 radix 힙. 음이 아닌 float는 비트 패턴의 대소가 값의 대소와 같으므로
+// 비용을 그대로 32비트 키로 쓴다. 마지막으로 꺼낸 키(last)와 처음 달라지는 비트 위치로
+// 버킷을 나누고, decrease-key 대신 새 항목을 넣고 낡은 항목은 꺼낼 때 버린다.
+#define RADIX_BUCKETS 33
+
+typedef struct RadixEntry {
+    unsigned key;
+    int v;
+} RadixEntry;
+
+typedef struct RadixHeap {
+    RadixEntry* bucket[RADIX_BUCKETS];
+    int size[RADIX_BUCKETS];
+    int cap[RADIX_BUCKETS];
+    unsigned last;
+    int count;
+} RadixHeap;
+
+unsigned floatKey(float f) {
+    unsigned k;
+    memcpy(&k, &f, sizeof(k));
+    return k;
+}
+
+int radixBucketOf(unsigned key, unsigned last) {
+    unsigned x = key ^ last;
+    int b = 0;
+    while (x) { b++; x >>= 1; }
+    return b;
+}
+
+// 버킷 메모리는 남겨두고 내용만 비움
+void radixClear(RadixHeap* r) {
+    for (int i = 0; i < RADIX_BUCKETS; i++) r->size[i] = 0;
+    r->last = 0;
+    r->count = 0;
+}
+
+void radixFree(RadixHeap* r) {
+    for (int i = 0; i < RADIX_BUCKETS; i++) free(r->bucket[i]);
+}
+
+void radixAppend(RadixHeap* r, int b, RadixEntry entry) {
+    if (r->size[b] == r->cap[b]) {
+        r->cap[b] = r->cap[b] ? r->cap[b] * 2 : 16;
+        r->bucket[b] = (RadixEntry*)realloc(r->bucket[b], sizeof(RadixEntry) * r->cap[b]);
+    }
+    r->bucket[b][r->size[b]++] = entry;
+}
+
+void radixPush(RadixHeap* r, float cost, int v) {
+    RadixEntry entry = { floatKey(cost), v };
+    radixAppend(r, radixBucketOf(entry.key, r->last), entry);
+    r->count++;
+}
+
+// 가장 작은 비용의 역을 꺼냄. 이미 방문했거나 비용이 갱신된 항목은 버린다
+int radixPop(RadixHeap* r, const float* cost, const unsigned* settled, unsigned generation) {
+    while (r->count > 0) {
+        if (r->size[0] == 0) {
+            int b = 1;
+            while (r->size[b] == 0) b++;
+            unsigned minKey = r->bucket[b][0].key;
+            for (int i = 1; i < r->size[b]; i++)
+                if (r->bucket[b][i].key < minKey) minKey = r->bucket[b][i].key;
+            r->last = minKey;
+            for (int i = 0; i < r->size[b]; i++)
+                radixAppend(r, radixBucketOf(r->bucket[b][i].key, minKey), r->bucket[b][i]);
+            r->size[b] = 0;
+        }
+
+        // 버킷 0은 모두 같은 비용이므로 번호가 가장 작은 역을 고른다
+        int best = -1;
+        for (int i = 0; i < r->size[0]; ) {
+            RadixEntry entry = r->bucket[0][i];
+            if (settled[entry.v] == generation || floatKey(cost[entry.v]) != entry.key) {
+                r->bucket[0][i] = r->bucket[0][--r->size[0]];
+                r->count--;
+                continue;
+            }
+            if (best == -1 || entry.v < r->bucket[0][best].v) best = i;
+            i++;
+        }
+        if (best == -1) continue;
+
+        int v = r->bucket[0][best].v;
+        r->bucket[0][best] = r->bucket[0][--r->size[0]];
+        r->count--;
+        return v;
+    }
+    return -1;
+}
+
+// ---------------------- 길찾기 ----------------------
+
+// 길찾기 작업 공간. 질의마다 할당하지 않고 역 수에 맞춰 늘려가며 재사용한다.
+// 배열을 매번 초기화하지 않고 세대 번호(generation)로 이번 질의에서 건드린 역만 구분해서,
+// 질의 비용이 전체 역 수가 아니라 실제로 탐색한 역 수에 비례하도록 한다
+typedef struct SearchContext {
+    int capacity;
+    unsigned generation;
+    int settledCount;   // 이번 질의에서 확정한 역 수 (탐색 방식 비교용)
+    unsigned* seen;     // seen[v] == generation 이면 이번 질의에서 라벨을 채운 역
+    unsigned* settled;  // settled[v] == generation 이면 이번 질의에서 확정된 역
+    float* cost;
+    float* dist;
+    float* key;         // A* 탐색의 우선순위 (cost + 남은 비용 하한)
+    int* prev;
+    int* prevLine;
+    int* path;
+    IndexedHeap heap;
+    RadixHeap radix;
+} SearchContext;
+
+SearchContext searchContext;     // 역 단위 결과 (findPath 출력용)
+SearchContext routeContext;      // 노선 그래프 탐색용 (노드 단위)
+SearchContext backwardContext;   // 양방향 탐색의 도착역 쪽 (노드 단위)
+
+void reserveSearchContext(SearchContext* ctx, int n) {
+    if (n <= ctx->capacity) return;
+    int capacity = ctx->capacity ? ctx->capacity : 256;
+    while (capacity < n) capacity *= 2;
+
+    ctx->seen = (unsigned*)realloc(ctx->seen, sizeof(unsigned) * capacity);
+    ctx->settled = (unsigned*)realloc(ctx->settled, sizeof(unsigned) * capacity);
+    for (int i = ctx->capacity; i < capacity; i++) {
+        ctx->seen[i] = 0;
+        ctx->settled[i] = 0;
+    }
+    ctx->cost = (float*)realloc(ctx->cost, sizeof(float) * capacity);
+    ctx->dist = (float*)realloc(ctx->dist, sizeof(float) * capacity);
+    ctx->key = (float*)realloc(ctx->key, sizeof(float) * capacity);
+    ctx->prev = (int*)realloc(ctx->prev, sizeof(int) * capacity);
+    ctx->prevLine = (int*)realloc(ctx->prevLine, sizeof(int) * capacity);
+    ctx->path = (int*)realloc(ctx->path, sizeof(int) * capacity);
+    heapReserve(&ctx->heap, capacity, ctx->capacity);
+    ctx->capacity = capacity;
+}
+
+void freeSearchContext(SearchContext* ctx) {
+    free(ctx->seen);
+    free(ctx->settled);
+    free(ctx->cost);
+    free(ctx->dist);
+    free(ctx->key);
+    free(ctx->prev);
+    free(ctx->prevLine);
+    free(ctx->path);
+    free(ctx->heap.heap);
+    free(ctx->heap.pos);
+    radixFree(&ctx->radix);
+    memset(ctx, 0, sizeof(SearchContext));
+}
+
+// 새 질의 시작. 세대 번호만 올리고, 한 바퀴 돌아 0이 되면 그때만 전체를 지운다
+void beginSearch(SearchContext* ctx) {
+    if (++ctx->generation == 0) {
+        memset(ctx->seen, 0, sizeof(unsigned) * ctx->capacity);
+        memset(ctx->settled, 0, sizeof(unsigned) * ctx->capacity);
+        ctx->generation = 1;
+    }
+    ctx->settledCount = 0;
+}
+
+// 이번 질의에서 처음 만난 역이면 라벨을 초기값으로 채움
+void touchStation(SearchContext* ctx, int v) {
+    if (ctx->seen[v] == ctx->generation) return;
+    ctx->seen[v] = ctx->generation;
+    ctx->cost[v] = INT_MAX;
+    ctx->prev[v] = -1;
+    ctx->prevLine[v] = 0;
+    ctx->dist[v] = 0.0f;
+}
+
+int isReached(const SearchContext* ctx, int v) {
+    return ctx->seen[v] == ctx->generation && ctx->cost[v] != INT_MAX;
+}
+
+int isSettled(const SearchContext* ctx, int v) {
+    return ctx->settled[v] == ctx->generation;
+}
+
+// 노선 그래프에서 찾은 (역, 호선) 노드 경로를 역 단위 라벨로 옮겨서 findPath가 그대로 출력하게 함
+void beginRouteResult(SearchContext* ctx, int start, int settledCount) {
+    reserveSearchContext(ctx, stationCount);
+    beginSearch(ctx);
+    ctx->settledCount = settledCount;
+    touchStation(ctx, start);
+    ctx->cost[start] = 0;
+}
+
+// 노드 a -> b 간선 하나를 기록. 역이 바뀌는 운행 간선만 남기고 환승/승하차 간선은 건너뛴다
+void addRouteStep(SearchContext* ctx, int a, int b, float km) {
+    if (a >= routeGraph.routeNodeCount || b >= routeGraph.routeNodeCount) return;
+    int s = routeGraph.nodeStation[a], t = routeGraph.nodeStation[b];
+    if (s == t) return;
+    touchStation(ctx, t);
+    ctx->prev[t] = s;
+    ctx->prevLine[t] = routeGraph.nodeLine[b];
+    ctx->dist[t] = ctx->dist[s] + km;
+}
+
+// 노드 단위 탐색 rc의 source -> sink 경로를 역 단위로 옮김
+int copyRoutePath(SearchContext* ctx, SearchContext* rc, int start, int end, int source, int sink) {
+    beginRouteResult(ctx, start, rc->settledCount);
+    if (!isReached(rc, sink)) return 0;
+
+    // 도착 노드에서 prev를 따라 거꾸로 모은 뒤 출발 쪽부터 옮긴다
+    int count = 0;
+    for (int v = sink; v != source; v = rc->prev[v]) rc->path[count++] = v;
+    rc->path[count++] = source;
+    for (int i = count - 1; i > 0; i--) {
+        int a = rc->path[i], b = rc->path[i - 1];
+        addRouteStep(ctx, a, b, rc->dist[b] - rc->dist[a]);
+    }
+    ctx->cost[end] = rc->cost[sink];
+    ctx->dist[end] = rc->dist[sink];
+    return 1;
+}
+
+// 노선 그래프에서 source 노드부터의 최단 경로 트리를 구함 (searchEngine에 따라 큐 선택).
+// target이 -1이 아니면 그 노드가 확정되는 순간 멈춘다
+void shortestPathTree(SearchContext* ctx, int source, int target, int mode) {
+    ensureRouteGraph();
+    int N = routeGraph.nodeCount;
+    reserveSearchContext(ctx, N);
+    beginSearch(ctx);
+    float* cost = ctx->cost;
+    float* dist = ctx->dist;
+    int* prev = ctx->prev;
+    IndexedHeap* heap = &ctx->heap;
+    RadixHeap* radix = &ctx->radix;
+
+    touchStation(ctx, source);
+    cost[source] = 0;
+    if (searchEngine == ENGINE_BINARY_HEAP) {
+        heapClear(heap, cost);
+        heapPush(heap, source);
+    }
+    else if (searchEngine == ENGINE_RADIX_HEAP) {
+        radixClear(radix);
+        radixPush(radix, 0.0f, source);
+    }
+
+    while (1) {
+        int u = -1;
+        if (searchEngine == ENGINE_BINARY_HEAP) {
+            u = heapPop(heap);
+        }
+        else if (searchEngine == ENGINE_RADIX_HEAP) {
+            u = radixPop(radix, cost, ctx->settled, ctx->generation);
+        }
+        else {
+            float minCost = INT_MAX;
+            for (int j = 0; j < N; j++) {
+                if (ctx->seen[j] == ctx->generation && !isSettled(ctx, j) && cost[j] < minCost) {
+                    minCost = cost[j];
+                    u = j;
+                }
+            }
+        }
+        if (u == -1) break;
+        ctx->settled[u] = ctx->generation;
+        ctx->settledCount++;
+        if (u == target) break;
+
+        for (int k = routeGraph.offsets[u]; k < routeGraph.offsets[u + 1]; k++) {
+            int v = routeGraph.target[k];
+            if (isSettled(ctx, v)) continue;
+            touchStation(ctx, v);
+            float weight = routeWeight(k, mode);
+            if (cost[u] + weight < cost[v]) {
+                cost[v] = cost[u] + weight;
+                prev[v] = u;
+                dist[v] = dist[u] + routeGraph.km[k];
+                if (searchEngine == ENGINE_BINARY_HEAP) heapPush(heap, v);
+                else if (searchEngine == ENGINE_RADIX_HEAP) radixPush(radix, cost[v], v);
+            }
+        }
+    }
+}
+
+// 양방향 Dijkstra (모드 1, 2 전용, 큐는 이진 힙). 도착 쪽은 노선 그래프의 역방향 CSR을 따라간다.
+// 찾은 경로는 역 단위로 ctx에 채워서 findPath가 그대로 출력할 수 있게 한다
+int bidirectionalSearch(SearchContext* ctx, int start, int end, int mode) {
+    ensureRouteGraph();
+    int N = routeGraph.nodeCount;
+    SearchContext* fwd = &routeContext;
+    SearchContext* bwd = &backwardContext;
+    reserveSearchContext(fwd, N);
+    reserveSearchContext(bwd, N);
+    beginSearch(fwd);
+    beginSearch(bwd);
+    heapClear(&fwd->heap, fwd->cost);
+    heapClear(&bwd->heap, bwd->cost);
+
+    int source = departNode(start), sink = arriveNode(end);
+    touchStation(fwd, source);
+    fwd->cost[source] = 0;
+    heapPush(&fwd->heap, source);
+    touchStation(bwd, sink);
+    bwd->cost[sink] = 0;
+    heapPush(&bwd->heap, sink);
+
+    float best = INT_MAX;
+    int meetFwd = -1, meetBwd = -1;
+    float meetKm = 0.0f;
+
+    while (fwd->heap.size > 0 && bwd->heap.size > 0) {
+        float topF = fwd->cost[fwd->heap.heap[0]];
+        float topB = bwd->cost[bwd->heap.heap[0]];
+        if (topF + topB >= best) break;  // 남은 어떤 경로도 best보다 짧을 수 없음
+
+        // 맨 앞 비용이 작은 쪽을 한 칸 확장
+        int forward = topF <= topB;
+        SearchContext* side = forward ? fwd : bwd;
+        SearchContext* other = forward ? bwd : fwd;
+        int u = heapPop(&side->heap);
+        side->settled[u] = side->generation;
+        side->settledCount++;
+
+        int first = forward ? routeGraph.offsets[u] : routeGraph.rOffsets[u];
+        int last = forward ? routeGraph.offsets[u + 1] : routeGraph.rOffsets[u + 1];
+        for (int i = first; i < last; i++) {
+            int k = forward ? i : routeGraph.rEdge[i];
+            int v = forward ? routeGraph.target[i] : routeGraph.rSource[i];
+            float weight = routeWeight(k, mode);
+
+            // 반대쪽 탐색이 이미 닿은 노드면 그 노드를 지나는 경로가 후보
+            if (isReached(other, v) && side->cost[u] + weight + other->cost[v] < best) {
+                best = side->cost[u] + weight + other->cost[v];
+                meetFwd = forward ? u : v;
+                meetBwd = forward ? v : u;
+                meetKm = routeGraph.km[k];
+            }
+
+            if (isSettled(side, v)) continue;
+            touchStation(side, v);
+            if (side->cost[u] + weight < side->cost[v]) {
+                side->cost[v] = side->cost[u] + weight;
+                side->prev[v] = u;
+                side->dist[v] = side->dist[u] + routeGraph.km[k];
+                heapPush(&side->heap, v);
+            }
+        }
+    }
+
+    beginRouteResult(ctx, start, fwd->settledCount + bwd->settledCount);
+    if (meetFwd == -1) return 0;
+
+    // 출발 쪽은 prev를 거꾸로 모아 뒤집고, 만난 간선 뒤로 도착 쪽 prev를 순서대로 따라간다
+    int count = 0;
+    for (int v = meetFwd; v != source; v = fwd->prev[v]) fwd->path[count++] = v;
+    fwd->path[count++] = source;
+    for (int i = count - 1; i > 0; i--) {
+        int a = fwd->path[i], b = fwd->path[i - 1];
+        addRouteStep(ctx, a, b, fwd->dist[b] - fwd->dist[a]);
+    }
+    addRouteStep(ctx, meetFwd, meetBwd, meetKm);
+    for (int a = meetBwd; a != sink; a = bwd->prev[a]) {
+        int b = bwd->prev[a];
+        addRouteStep(ctx, a, b, bwd->dist[a] - bwd->dist[b]);
+    }
+    ctx->cost[end] = best;
+    ctx->dist[end] = fwd->dist[meetFwd] + meetKm + bwd->dist[meetBwd];
+    return 1;
+}
+
+// ---------------------- Contraction Hierarchies ----------------------
+
+// 노선 그래프를 중요도 순으로 하나씩 축약하면서 지름길(shortcut) 간선을 추가해 둔 구조.
+// 질의는 출발 노드에서 순위가 올라가는 간선만, 도착 노드에서 거꾸로 순위가 올라가는 간선만
+// 따라가므로 몇 백 개 노드만 보고 끝난다.
+// 지름길은 witness 탐색으로 거르지 않고 축약할 때 생기는 것을 모두 남긴다. 그래서 지름길 구조가 비용과 무관하고,
+// 축약은 한 번만 해서 시간(모드 1)과 거리(모드 2)가 같이 쓴다. 모드마다, 그리고 구간 통제로 비용이 바뀔 때마다
+// customizeHierarchy로 간선 비용만 채운다 (CRP/CCH의 customization)
+#define CH_FILE_VERSION 3
+
+typedef struct ChEdge {
+    int from;
+    int to;
+    int routeEdge; // 노선 그래프 간선에서 온 간선이면 그 번호 (지름길만이면 -1)
+} ChEdge;
+
+// 모드별 간선 비용 (customization 결과)
+typedef struct ChCost {
+    float weight;
+    float km;
+    int child1;  // 지름길이면 가장 싸게 이어 붙인 두 간선 번호, 원래 간선이 더 싸면 -1
+    int child2;
+} ChCost;
+
+typedef struct ContractionHierarchy {
+    int version;          // 만들 때의 graphVersion (-1: 없음)
+    unsigned fingerprint;
+    int nodeCount;
+    int edgeCount;
+    ChEdge* edges;
+    int* upOffsets;       // 노드 -> 순위가 더 높은 노드로 가는 간선 번호 목록
+    int* upEdges;
+    int* downOffsets;     // 순위가 더 높은 노드 -> 노드 간선 번호 목록 (도착 쪽 탐색용)
+    int* downEdges;
+    int triangleCount;    // customization 순서대로 (u -> v, v -> x, u -> x) 간선 번호. 파일에는 없고 처음 쓸 때 만든다
+    int* triangles;
+    ChCost* costs[2];     // [0] 시간, [1] 거리
+    int metric[2];        // 모드별로 비용을 채운 노선 그래프의 metric (-1: 아직)
+} ContractionHierarchy;
+
+ContractionHierarchy hierarchy = { .version = -1, .metric = { -1, -1 } };
+SearchContext chForward;
+SearchContext chBackward;
+
+// 축약 중에 쓰는 가변 인접 목록
+typedef struct IntList {
+    int* items;
+    int size;
+    int cap;
+} IntList;
+
+void intListPush(IntList* list, int value) {
+    if (list->size == list->cap) {
+        list->cap = list->cap ? list->cap * 2 : 4;
+        list->items = (int*)realloc(list->items, sizeof(int) * list->cap);
+    }
+    list->items[list->size++] = value;
+}
+
+typedef struct ChBuilder {
+    int nodeCount;
+    ChEdge* edges;
+    int edgeCount;
+    int edgeCap;
+    IntList* out;
+    IntList* in;
+    int* contracted;
+    int* deletedNeighbors;
+} ChBuilder;
+
+int chAddEdge(ChBuilder* b, int from, int to, int routeEdge) {
+    if (b->edgeCount == b->edgeCap) {
+        b->edgeCap = b->edgeCap ? b->edgeCap * 2 : 1024;
+        b->edges = (ChEdge*)realloc(b->edges, sizeof(ChEdge) * b->edgeCap);
+    }
+    ChEdge edge = { from, to, routeEdge };
+    b->edges[b->edgeCount] = edge;
+    intListPush(&b->out[from], b->edgeCount);
+    intListPush(&b->in[to], b->edgeCount);
+    return b->edgeCount++;
+}
+
+// v를 축약할 때 필요한 지름길 수를 셈. simulate가 0이면 실제로 지름길을 추가한다.
+// 남은 이웃 u -> v -> x 쌍마다 지름길을 하나씩 둔다 (이미 u -> x 간선이 있으면 그 간선을 같이 씀)
+int chContract(ChBuilder* b, int v, int simulate) {
+    int shortcuts = 0;
+    IntList* in = &b->in[v];
+    IntList* out = &b->out[v];
+    for (int i = 0; i < in->size; i++) {
+        int e1 = in->items[i];
+        int u = b->edges[e1].from;
+        if (b->contracted[u] || u == v) continue;
+
+        for (int j = 0; j < out->size; j++) {
+            int e2 = out->items[j];
+            int x = b->edges[e2].to;
+            if (b->contracted[x] || x == u || x == v) continue;
+
+            int existing = -1;
+            for (int k = 0; k < b->out[u].size; k++)
+                if (b->edges[b->out[u].items[k]].to == x) { existing = b->out[u].items[k]; break; }
+            if (existing != -1) continue;
+            shortcuts++;
+            if (simulate) continue;
+            chAddEdge(b, u, x, -1);
+        }
+    }
+    return shortcuts;
+}
+
+// 축약 우선순위: (추가될 지름길 - 없어지는 간선) + 이미 축약된 이웃 수
+float chPriority(ChBuilder* b, int v) {
+    int degree = 0;
+    for (int i = 0; i < b->in[v].size; i++)
+        if (!b->contracted[b->edges[b->in[v].items[i]].from]) degree++;
+    for (int i = 0; i < b->out[v].size; i++)
+        if (!b->contracted[b->edges[b->out[v].items[i]].to]) degree++;
+    int shortcuts = chContract(b, v, 1);
+    return (float)(2 * shortcuts - degree + b->deletedNeighbors[v]);
+}
+
+void freeHierarchy(ContractionHierarchy* ch) {
+    free(ch->edges);
+    free(ch->upOffsets);
+    free(ch->upEdges);
+    free(ch->downOffsets);
+    free(ch->downEdges);
+    free(ch->triangles);
+    free(ch->costs[0]);
+    free(ch->costs[1]);
+    memset(ch, 0, sizeof(ContractionHierarchy));
+    ch->version = -1;
+    ch->metric[0] = ch->metric[1] = -1;
+}
+
+void buildHierarchy(ContractionHierarchy* ch) {
+    int N = routeGraph.nodeCount;
+    ChBuilder b;
+    memset(&b, 0, sizeof(b));
+    b.nodeCount = N;
+    b.out = (IntList*)calloc(N, sizeof(IntList));
+    b.in = (IntList*)calloc(N, sizeof(IntList));
+    b.contracted = (int*)calloc(N, sizeof(int));
+    b.deletedNeighbors = (int*)calloc(N, sizeof(int));
+
+    for (int u = 0; u < N; u++)
+        for (int k = routeGraph.offsets[u]; k < routeGraph.offsets[u + 1]; k++)
+            chAddEdge(&b, u, routeGraph.target[k], k);
+
+    // 우선순위가 낮은 노드부터 축약 (꺼낼 때 다시 계산해서 여전히 가장 낮을 때만 축약)
+    float* priority = (float*)malloc(sizeof(float) * N);
+    int* rank = (int*)malloc(sizeof(int) * N);
+    IndexedHeap order;
+    memset(&order, 0, sizeof(order));
+    heapReserve(&order, N, 0);
+    heapClear(&order, priority);
+    for (int v = 0; v < N; v++) {
+        priority[v] = chPriority(&b, v);
+        heapPush(&order, v);
+    }
+
+    int nextRank = 0;
+    while (order.size > 0) {
+        int v = heapPop(&order);
+        float updated = chPriority(&b, v);
+        if (order.size > 0 && updated > priority[order.heap[0]]) {
+            priority[v] = updated;
+            heapPush(&order, v);
+            continue;
+        }
+        chContract(&b, v, 0);
+        b.contracted[v] = 1;
+        rank[v] = nextRank++;
+        for (int i = 0; i < b.in[v].size; i++) b.deletedNeighbors[b.edges[b.in[v].items[i]].from]++;
+        for (int i = 0; i < b.out[v].size; i++) b.deletedNeighbors[b.edges[b.out[v].items[i]].to]++;
+    }
+
+    // 순위가 올라가는 간선은 출발 노드 쪽에, 내려가는 간선은 도착 노드 쪽에 모은다
+    freeHierarchy(ch);
+    ch->nodeCount = N;
+    ch->edgeCount = b.edgeCount;
+    ch->edges = b.edges;
+    ch->upOffsets = (int*)calloc(N + 1, sizeof(int));
+    ch->downOffsets = (int*)calloc(N + 1, sizeof(int));
+    for (int e = 0; e < b.edgeCount; e++) {
+        if (rank[b.edges[e].to] > rank[b.edges[e].from]) ch->upOffsets[b.edges[e].from + 1]++;
+        else ch->downOffsets[b.edges[e].to + 1]++;
+    }
+    for (int v = 0; v < N; v++) {
+        ch->upOffsets[v + 1] += ch->upOffsets[v];
+        ch->downOffsets[v + 1] += ch->downOffsets[v];
+    }
+    ch->upEdges = (int*)malloc(sizeof(int) * (ch->upOffsets[N] + 1));
+    ch->downEdges = (int*)malloc(sizeof(int) * (ch->downOffsets[N] + 1));
+    int* upFill = (int*)malloc(sizeof(int) * N);
+    int* downFill = (int*)malloc(sizeof(int) * N);
+    memcpy(upFill, ch->upOffsets, sizeof(int) * N);
+    memcpy(downFill, ch->downOffsets, sizeof(int) * N);
+    for (int e = 0; e < b.edgeCount; e++) {
+        if (rank[b.edges[e].to] > rank[b.edges[e].from]) ch->upEdges[upFill[b.edges[e].from]++] = e;
+        else ch->downEdges[downFill[b.edges[e].to]++] = e;
+    }
+
+    free(upFill);
+    free(downFill);
+    for (int v = 0; v < N; v++) {
+        free(b.out[v].items);
+        free(b.in[v].items);
+    }
+    free(b.out);
+    free(b.in);
+    free(b.contracted);
+    free(b.deletedNeighbors);
+    free(priority);
+    free(rank);
+    free(order.heap);
+    free(order.pos);
+}
+
+// CH 파일은 스냅샷/변경 기록처럼 노선도 경로 옆에 둔다 (<노선도>.ch)
+char hierarchyNetworkPath[1024] = "subway_line.csv";
+char hierarchyPath[1040];
+
+const char* hierarchyFileName() {
+    snprintf(hierarchyPath, sizeof(hierarchyPath), "%s.ch", hierarchyNetworkPath);
+    return hierarchyPath;
+}
+
+// 파일 형식: "SDCH", 버전, 노선 그래프 해시, 노드 수, 간선 수, 간선, up/down 목록, 내용 해시 (비용은 불러와서 채운다).
+// 스냅샷처럼 임시 파일에 다 쓴 뒤 바꿔 넣으므로 쓰다 끊겨도 예전 CH 파일이 남는다
+void saveHierarchy(const ContractionHierarchy* ch, const char* filename) {
+    char tempName[1056];
+    snprintf(tempName, sizeof(tempName), "%s.tmp", filename);
+    FILE* file = fopen(tempName, "wb");
+    if (!file) {
+        printf("CH 파일을 저장할 수 없습니다: %s\n", filename);
+        return;
+    }
+    int version = CH_FILE_VERSION;
+    int N = ch->nodeCount;
+    int ok = fwrite("SDCH", 1, 4, file) == 4
+        && fwrite(&version, sizeof(int), 1, file) == 1
+        && fwrite(&ch->fingerprint, sizeof(unsigned), 1, file) == 1
+        && fwrite(&N, sizeof(int), 1, file) == 1
+        && fwrite(&ch->edgeCount, sizeof(int), 1, file) == 1;
+
+    unsigned h = 2166136261u;
+    h = hashBytes(h, ch->edges, sizeof(ChEdge) * ch->edgeCount);
+    h = hashBytes(h, ch->upOffsets, sizeof(int) * (N + 1));
+    h = hashBytes(h, ch->upEdges, sizeof(int) * ch->upOffsets[N]);
+    h = hashBytes(h, ch->downOffsets, sizeof(int) * (N + 1));
+    h = hashBytes(h, ch->downEdges, sizeof(int) * ch->downOffsets[N]);
+    ok = ok && fwrite(ch->edges, sizeof(ChEdge), ch->edgeCount, file) == (size_t)ch->edgeCount
+        && fwrite(ch->upOffsets, sizeof(int), N + 1, file) == (size_t)(N + 1)
+        && fwrite(ch->upEdges, sizeof(int), ch->upOffsets[N], file) == (size_t)ch->upOffsets[N]
+        && fwrite(ch->downOffsets, sizeof(int), N + 1, file) == (size_t)(N + 1)
+        && fwrite(ch->downEdges, sizeof(int), ch->downOffsets[N], file) == (size_t)ch->downOffsets[N]
+        && fwrite(&h, sizeof(unsigned), 1, file) == 1;
+    if (fclose(file) != 0) ok = 0;
+    if (!ok || !replaceFile(tempName, filename)) {
+        printf("CH 파일을 저장할 수 없습니다: %s\n", filename);
+        remove(tempName);
+    }
+}
+
+// 현재 노선 그래프와 같은 그래프로 만든 파일일 때만 불러옴
+int loadHierarchy(ContractionHierarchy* ch, const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) return 0;
+
+    char magic[4];
+    int version, N, edgeCount;
+    unsigned fingerprint;
+    int ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, "SDCH", 4) == 0
+        && fread(&version, sizeof(int), 1, file) == 1 && version == CH_FILE_VERSION
+        && fread(&fingerprint, sizeof(unsigned), 1, file) == 1 && fingerprint == routeGraph.fingerprint
+        && fread(&N, sizeof(int), 1, file) == 1 && N == routeGraph.nodeCount
+        && fread(&edgeCount, sizeof(int), 1, file) == 1 && edgeCount >= 0;
+    if (!ok) {
+        fclose(file);
+        return 0;
+    }
+
+    freeHierarchy(ch);
+    ch->fingerprint = fingerprint;
+    ch->nodeCount = N;
+    ch->edgeCount = edgeCount;
+    ch->edges = (ChEdge*)malloc(sizeof(ChEdge) * (edgeCount + 1));
+    ch->upOffsets = (int*)malloc(sizeof(int) * (N + 1));
+    ch->downOffsets = (int*)malloc(sizeof(int) * (N + 1));
+    ok = fread(ch->edges, sizeof(ChEdge), edgeCount, file) == (size_t)edgeCount
+        && fread(ch->upOffsets, sizeof(int), N + 1, file) == (size_t)(N + 1)
+        && ch->upOffsets[N] >= 0 && ch->upOffsets[N] <= edgeCount;
+    if (ok) {
+        ch->upEdges = (int*)malloc(sizeof(int) * (ch->upOffsets[N] + 1));
+        ok = fread(ch->upEdges, sizeof(int), ch->upOffsets[N], file) == (size_t)ch->upOffsets[N]
+            && fread(ch->downOffsets, sizeof(int), N + 1, file) == (size_t)(N + 1)
+            && ch->downOffsets[N] >= 0 && ch->downOffsets[N] <= edgeCount;
+    }
+    if (ok) {
+        ch->downEdges = (int*)malloc(sizeof(int) * (ch->downOffsets[N] + 1));
+        unsigned stored;
+        ok = fread(ch->downEdges, sizeof(int), ch->downOffsets[N], file) == (size_t)ch->downOffsets[N]
+            && fread(&stored, sizeof(unsigned), 1, file) == 1;
+        if (ok) {
+            unsigned h = 2166136261u;
+            h = hashBytes(h, ch->edges, sizeof(ChEdge) * edgeCount);
+            h = hashBytes(h, ch->upOffsets, sizeof(int) * (N + 1));
+            h = hashBytes(h, ch->upEdges, sizeof(int) * ch->upOffsets[N]);
+            h = hashBytes(h, ch->downOffsets, sizeof(int) * (N + 1));
+            h = hashBytes(h, ch->downEdges, sizeof(int) * ch->downOffsets[N]);
+            ok = h == stored;
+        }
+    }
+    fclose(file);
+    if (!ok) freeHierarchy(ch);
+    return ok;
+}
+
+// customization에 쓸 삼각형 목록. 가운데 노드 v로 내려왔다 올라가는 u -> v -> x마다 u -> x 간선이 있으므로
+// (축약할 때 만들었음), v가 낮은 노드부터 (u -> v, v -> x, u -> x)를 적어 둔다.
+// 순위는 파일에 없으므로 순위가 올라가는 간선을 따라 위상 정렬한 순서를 쓴다 (이웃끼리는 순위 순서와 같다)
+void buildTriangles(ContractionHierarchy* ch) {
+    int N = ch->nodeCount;
+    int* lower = (int*)calloc(N > 0 ? N : 1, sizeof(int));  // 아직 처리하지 않은 아래 이웃 수
+    int* order = (int*)malloc(sizeof(int) * (N > 0 ? N : 1));
+    int* position = (int*)malloc(sizeof(int) * (N > 0 ? N : 1));
+    for (int v = 0; v < N; v++) {
+        for (int i = ch->upOffsets[v]; i < ch->upOffsets[v + 1]; i++)
+            if (ch->edges[ch->upEdges[i]].to != v) lower[ch->edges[ch->upEdges[i]].to]++;
+        for (int i = ch->downOffsets[v]; i < ch->downOffsets[v + 1]; i++)
+            if (ch->edges[ch->downEdges[i]].from != v) lower[ch->edges[ch->downEdges[i]].from]++;
+    }
+    int head = 0, tail = 0;
+    for (int v = 0; v < N; v++)
+        if (lower[v] == 0) order[tail++] = v;
+    while (head < tail) {
+        int v = order[head];
+        position[v] = head++;
+        for (int i = ch->upOffsets[v]; i < ch->upOffsets[v + 1]; i++) {
+            int x = ch->edges[ch->upEdges[i]].to;
+            if (x != v && --lower[x] == 0) order[tail++] = x;
+        }
+        for (int i = ch->downOffsets[v]; i < ch->downOffsets[v + 1]; i++) {
+            int u = ch->edges[ch->downEdges[i]].from;
+            if (u != v && --lower[u] == 0) order[tail++] = u;
+        }
+    }
+
+    IntList list = { 0 };
+    for (int o = 0; o < tail; o++) {
+        int v = order[o];
+        for (int i = ch->downOffsets[v]; i < ch->downOffsets[v + 1]; i++) {
+            int e1 = ch->downEdges[i];
+            int u = ch->edges[e1].from;
+            if (u == v) continue;
+            for (int j = ch->upOffsets[v]; j < ch->upOffsets[v + 1]; j++) {
+                int e2 = ch->upEdges[j];
+                int x = ch->edges[e2].to;
+                if (x == v || x == u) continue;
+                // u -> x는 둘 중 낮은 쪽 목록에 있다
+                int shortcut = -1;
+                if (position[x] > position[u]) {
+                    for (int k = ch->upOffsets[u]; k < ch->upOffsets[u + 1] && shortcut == -1; k++)
+                        if (ch->edges[ch->upEdges[k]].to == x) shortcut = ch->upEdges[k];
+                }
+                else {
+                    for (int k = ch->downOffsets[x]; k < ch->downOffsets[x + 1] && shortcut == -1; k++)
+                        if (ch->edges[ch->downEdges[k]].from == u) shortcut = ch->downEdges[k];
+                }
+                if (shortcut == -1) continue;
+                intListPush(&list, e1);
+                intListPush(&list, e2);
+                intListPush(&list, shortcut);
+            }
+        }
+    }
+    free(ch->triangles);
+    ch->triangles = list.items;
+    ch->triangleCount = list.size / 3;
+    free(lower);
+    free(order);
+    free(position);
+}
+
+// 지금 노선 그래프 비용(구간 통제 반영)으로 모드의 간선 비용을 다시 채움. 원래 간선은 노선 그래프에서 가져오고,
+// 지름길은 아래 삼각형을 낮은 노드부터 훑어 가장 싼 u -> v -> x로 정한다 (아래쪽 간선은 이미 정해져 있음)
+void customizeHierarchy(ContractionHierarchy* ch, int mode) {
+    if (!ch->triangles) buildTriangles(ch);
+    ChCost* costs = (ChCost*)realloc(ch->costs[mode - 1], sizeof(ChCost) * (ch->edgeCount + 1));
+    ch->costs[mode - 1] = costs;
+    for (int e = 0; e < ch->edgeCount; e++) {
+        const ChEdge* edge = &ch->edges[e];
+        ChCost* cost = &costs[e];
+        cost->child1 = -1;
+        cost->child2 = -1;
+        if (edge->routeEdge != -1) {
+            cost->weight = routeWeight(edge->routeEdge, mode);
+            cost->km = routeGraph.km[edge->routeEdge];
+        }
+        else {
+            cost->weight = CLOSED_WEIGHT;
+            cost->km = 0.0f;
+        }
+    }
+    for (int t = 0; t < ch->triangleCount; t++) {
+        const int* tri = &ch->triangles[3 * t];
+        const ChCost* first = &costs[tri[0]];
+        const ChCost* second = &costs[tri[1]];
+        ChCost* shortcut = &costs[tri[2]];
+        float weight = first->weight + second->weight;
+        if (weight < shortcut->weight) {
+            shortcut->weight = weight;
+            shortcut->km = first->km + second->km;
+            shortcut->child1 = tri[0];
+            shortcut->child2 = tri[1];
+        }
+    }
+    ch->metric[mode - 1] = routeGraph.metric;
+}
+
+// 모드에 맞는 CH 준비. 그래프가 바뀌었으면 파일에서 불러오거나 새로 축약해서 저장하고 (두 모드가 같이 씀),
+// 이 모드 비용을 아직 안 채웠거나 구간 통제가 바뀌었으면 비용만 다시 채운다
+ContractionHierarchy* ensureHierarchy(int mode) {
+    ensureRouteGraph();
+    ContractionHierarchy* ch = &hierarchy;
+    if (ch->version != graphVersion || ch->fingerprint != routeGraph.fingerprint) {
+        if (!loadHierarchy(ch, hierarchyFileName())) {
+            printf("CH 전처리 중... ");
+            clock_t begin = clock();
+            buildHierarchy(ch);
+            ch->fingerprint = routeGraph.fingerprint;
+            printf("완료 (%.0f ms, 간선 %d개)\n", (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC, ch->edgeCount);
+            saveHierarchy(ch, hierarchyFileName());
+        }
+        ch->version = graphVersion;
+    }
+    if (ch->metric[mode - 1] != routeGraph.metric) customizeHierarchy(ch, mode);
+    return ch;
+}
+
+// 지름길을 원래 노선 그래프 간선들로 풀어서 순서대로 out에 담음
+void chUnpack(const ChCost* costs, int e, IntList* out) {
+    if (costs[e].child1 == -1) {
+        intListPush(out, e);
+        return;
+    }
+    chUnpack(costs, costs[e].child1, out);
+    chUnpack(costs, costs[e].child2, out);
+}
+
+// CH 질의 (모드 1, 2). 찾은 경로는 역 단위로 ctx의 prev/prevLine/dist에 채워서 findPath가 출력한다
+int chSearch(SearchContext* ctx, int start, int end, int mode) {
+    ContractionHierarchy* ch = ensureHierarchy(mode);
+    const ChCost* costs = ch->costs[mode - 1];
+    int N = ch->nodeCount;
+    SearchContext* fwd = &chForward;
+    SearchContext* bwd = &chBackward;
+    reserveSearchContext(fwd, N);
+    reserveSearchContext(bwd, N);
+    beginSearch(fwd);
+    beginSearch(bwd);
+    heapClear(&fwd->heap, fwd->cost);
+    heapClear(&bwd->heap, bwd->cost);
+
+    int source = departNode(start), sink = arriveNode(end);
+    touchStation(fwd, source);
+    fwd->cost[source] = 0;
+    heapPush(&fwd->heap, source);
+    touchStation(bwd, sink);
+    bwd->cost[sink] = 0;
+    heapPush(&bwd->heap, sink);
+
+    float best = INT_MAX;
+    int meet = -1;
+    while (fwd->heap.size > 0 || bwd->heap.size > 0) {
+        // 각 방향은 맨 앞 비용이 best 이상이 되면 더 볼 필요가 없다
+        if (fwd->heap.size > 0 && fwd->cost[fwd->heap.heap[0]] >= best) heapClear(&fwd->heap, fwd->cost);
+        if (bwd->heap.size > 0 && bwd->cost[bwd->heap.heap[0]] >= best) heapClear(&bwd->heap, bwd->cost);
+        if (fwd->heap.size == 0 && bwd->heap.size == 0) break;
+
+        int forward = bwd->heap.size == 0
+            || (fwd->heap.size > 0 && fwd->cost[fwd->heap.heap[0]] <= bwd->cost[bwd->heap.heap[0]]);
+        SearchContext* side = forward ? fwd : bwd;
+        SearchContext* other = forward ? bwd : fwd;
+        int u = heapPop(&side->heap);
+        side->settled[u] = side->generation;
+        side->settledCount++;
+
+        if (isReached(other, u) && side->cost[u] + other->cost[u] < best) {
+            best = side->cost[u] + other->cost[u];
+            meet = u;
+        }
+
+        // stall-on-demand: 반대 방향 간선으로 더 싸게 올 수 있으면 이 노드는 최단이 아니므로 넘긴다
+        const int* stallOffsets = forward ? ch->downOffsets : ch->upOffsets;
+        const int* stallEdges = forward ? ch->downEdges : ch->upEdges;
+        int stalled = 0;
+        for (int i = stallOffsets[u]; i < stallOffsets[u + 1]; i++) {
+            const ChEdge* e = &ch->edges[stallEdges[i]];
+            int x = forward ? e->from : e->to;
+            if (isReached(side, x) && side->cost[x] + costs[stallEdges[i]].weight < side->cost[u]) { stalled = 1; break; }
+        }
+        if (stalled) continue;
+
+        const int* offsets = forward ? ch->upOffsets : ch->downOffsets;
+        const int* edges = forward ? ch->upEdges : ch->downEdges;
+        for (int i = offsets[u]; i < offsets[u + 1]; i++) {
+            int id = edges[i];
+            const ChEdge* e = &ch->edges[id];
+            int v = forward ? e->to : e->from;
+            if (isSettled(side, v)) continue;
+            touchStation(side, v);
+            if (side->cost[u] + costs[id].weight < side->cost[v]) {
+                side->cost[v] = side->cost[u] + costs[id].weight;
+                side->prev[v] = id;  // CH 탐색에서는 prev에 간선 번호를 넣는다
+                heapPush(&side->heap, v);
+            }
+        }
+    }
+
+    beginRouteResult(ctx, start, fwd->settledCount + bwd->settledCount);
+    if (meet == -1) return 0;
+
+    // 출발 쪽 간선은 거꾸로 모았다가 뒤집고, 도착 쪽은 순서대로 이어서 원래 간선으로 푼다
+    IntList chain = { 0 }, path = { 0 };
+    for (int v = meet; v != source; v = ch->edges[fwd->prev[v]].from) intListPush(&chain, fwd->prev[v]);
+    for (int i = 0, j = chain.size - 1; i < j; i++, j--) {
+        int t = chain.items[i]; chain.items[i] = chain.items[j]; chain.items[j] = t;
+    }
+    for (int v = meet; v != sink; v = ch->edges[bwd->prev[v]].to) intListPush(&chain, bwd->prev[v]);
+    for (int i = 0; i < chain.size; i++) chUnpack(costs, chain.items[i], &path);
+
+    for (int i = 0; i < path.size; i++) {
+        const ChEdge* e = &ch->edges[path.items[i]];
+        addRouteStep(ctx, e->from, e->to, costs[path.items[i]].km);
+    }
+    ctx->cost[end] = best;
+    free(chain.items);
+    free(path.items);
+    return 1;
+}
+
+// ---------------------- ALT (A*, 랜드마크) ----------------------
+
+// 랜드마크 역 몇 개에서 모든 역까지의 거리를 미리 구해 두고, 삼각 부등식
+// |d(L, t) - d(L, s)| <= d(s, t) 로 도착역까지 남은 비용의 하한을 잡아 A* 탐색에 쓴다.
+// 거리는 환승 패널티 없이 역 그래프에서 구하므로 노선 그래프의 어느 노드에서도 하한이 된다.
+// 편집으로 거리가 늘기만 했다면(호선/역 삭제) 예전 표도 여전히 하한이라 그대로 쓴다.
+// 구간 통제도 같은 이유로 표를 다시 만들지 않는다. 시간을 줄이는 배수가 있으면 그 배수만큼 하한을 줄여 쓴다
+#define ALT_LANDMARKS 8
+
+typedef struct LandmarkTable {
+    int valid;
+    int count;
+    int stationCount;
+    int landmarks[ALT_LANDMARKS];
+    float* dist;  // dist[s * ALT_LANDMARKS + i]: 랜드마크 i에서 역 s까지 (닿지 않으면 INT_MAX)
+} LandmarkTable;
+
+LandmarkTable landmarkTables[2];  // [0] 시간, [1] 거리
+
+// 역 그래프에서 환승 패널티 없이 source부터 모든 역까지의 거리 (랜드마크 표 계산용)
+void plainDistances(SearchContext* ctx, int source, int mode) {
+    reserveSearchContext(ctx, stationCount);
+    beginSearch(ctx);
+    heapClear(&ctx->heap, ctx->cost);
+    touchStation(ctx, source);
+    ctx->cost[source] = 0;
+    heapPush(&ctx->heap, source);
+    while (ctx->heap.size > 0) {
+        int u = heapPop(&ctx->heap);
+        ctx->settled[u] = ctx->generation;
+        for (int k = graph.offsets[u]; k < graph.offsets[u + 1]; k++) {
+            int v = graph.destIndex[k];
+            if (isSettled(ctx, v)) continue;
+            touchStation(ctx, v);
+            float weight = (mode == 1) ? graph.time[k] : graph.distance[k];
+            if (ctx->cost[u] + weight < ctx->cost[v]) {
+                ctx->cost[v] = ctx->cost[u] + weight;
+                heapPush(&ctx->heap, v);
+            }
+        }
+    }
+}
+
+// 랜드마크는 서로 가장 멀리 떨어진 역부터 고른다 (farthest-point)
+void buildLandmarks(LandmarkTable* table, int mode) {
+    SearchContext* ctx = &routeContext;
+    int V = stationCount;
+    table->stationCount = V;
+    table->count = 0;
+    table->dist = (float*)realloc(table->dist, sizeof(float) * (V ? V : 1) * ALT_LANDMARKS);
+    if (V == 0) {
+        table->valid = 1;
+        return;
+    }
+
+    // 첫 랜드마크는 0번 역에서 가장 먼 역
+    plainDistances(ctx, 0, mode);
+    int next = 0;
+    for (int s = 0; s < V; s++)
+        if (isReached(ctx, s) && ctx->cost[s] > ctx->cost[next]) next = s;
+
+    while (table->count < ALT_LANDMARKS) {
+        int i = table->count++;
+        table->landmarks[i] = next;
+        plainDistances(ctx, next, mode);
+        for (int s = 0; s < V; s++)
+            table->dist[s * ALT_LANDMARKS + i] = isReached(ctx, s) ? ctx->cost[s] : INT_MAX;
+
+        // 지금까지 고른 랜드마크들과의 최소 거리가 가장 큰 역이 다음 랜드마크
+        float farthest = 0.0f;
+        next = -1;
+        for (int s = 0; s < V; s++) {
+            float nearest = INT_MAX;
+            for (int j = 0; j < table->count; j++)
+                if (table->dist[s * ALT_LANDMARKS + j] < nearest) nearest = table->dist[s * ALT_LANDMARKS + j];
+            if (nearest != INT_MAX && nearest > farthest) {
+                farthest = nearest;
+                next = s;
+            }
+        }
+        if (next == -1) break;
+    }
+    table->valid = 1;
+}
+
+LandmarkTable* ensureLandmarks(int mode) {
+    ensureGraph();
+    if (landmarksStale) {
+        landmarkTables[0].valid = 0;
+        landmarkTables[1].valid = 0;
+        landmarksStale = 0;
+    }
+    LandmarkTable* table = &landmarkTables[mode - 1];
+    if (!table->valid || table->stationCount != stationCount) buildLandmarks(table, mode);
+    return table;
+}
+
+// 지운 역을 압축해서 번호를 다시 매길 때 표도 같이 옮김 (remap[s]: 새 번호, 지운 역은 -1).
+// 지운 역이 랜드마크였으면 그 열은 버린다
+void remapLandmarks(const int* remap, int oldCount, int newCount) {
+    for (int m = 0; m < 2; m++) {
+        LandmarkTable* table = &landmarkTables[m];
+        if (!table->valid || table->stationCount != oldCount) continue;
+        for (int s = 0; s < oldCount; s++)  // 새 번호는 항상 예전 번호 이하라 앞에서부터 옮기면 된다
+            if (remap[s] != -1 && remap[s] != s)
+                memcpy(&table->dist[remap[s] * ALT_LANDMARKS], &table->dist[s * ALT_LANDMARKS], sizeof(float) * ALT_LANDMARKS);
+        table->stationCount = newCount;
+
+        int kept = 0;
+        for (int i = 0; i < table->count; i++) {
+            if (remap[table->landmarks[i]] == -1) continue;
+            table->landmarks[kept] = remap[table->landmarks[i]];
+            if (kept != i)
+                for (int s = 0; s < table->stationCount; s++)
+                    table->dist[s * ALT_LANDMARKS + kept] = table->dist[s * ALT_LANDMARKS + i];
+            kept++;
+        }
+        table->count = kept;
+    }
+}
+
+// 역 s에서 도착역 t까지 남은 비용의 하한
+float altPotential(const LandmarkTable* table, int s, int t) {
+    const float* ds = &table->dist[s * ALT_LANDMARKS];
+    const float* dt = &table->dist[t * ALT_LANDMARKS];
+    float bound = 0.0f;
+    for (int i = 0; i < table->count; i++) {
+        if (ds[i] == INT_MAX || dt[i] == INT_MAX) continue;
+        float diff = dt[i] > ds[i] ? dt[i] - ds[i] : ds[i] - dt[i];
+        if (diff > bound) bound = diff;
+    }
+    return bound;
+}
+
+// 노선 그래프에서 A* 탐색 (모드 1, 2). 우선순위는 cost + 도착역까지의 하한
+int altSearch(SearchContext* ctx, int start, int end, int mode) {
+    ensureRouteGraph();
+    LandmarkTable* table = ensureLandmarks(mode);
+    SearchContext* rc = &routeContext;
+    reserveSearchContext(rc, routeGraph.nodeCount);
+    beginSearch(rc);
+    heapClear(&rc->heap, rc->key);
+
+    int source = departNode(start), sink = arriveNode(end);
+    float scale = (mode == 1) ? disruptionTimeScale : 1.0f;
+    touchStation(rc, source);
+    rc->cost[source] = 0;
+    rc->key[source] = scale * altPotential(table, start, end);
+    heapPush(&rc->heap, source);
+
+    while (rc->heap.size > 0) {
+        int u = heapPop(&rc->heap);
+        rc->settled[u] = rc->generation;
+        rc->settledCount++;
+        if (u == sink) break;
+
+        for (int k = routeGraph.offsets[u]; k < routeGraph.offsets[u + 1]; k++) {
+            int v = routeGraph.target[k];
+            if (isSettled(rc, v)) continue;
+            touchStation(rc, v);
+            float cost = rc->cost[u] + routeWeight(k, mode);
+            if (cost < rc->cost[v]) {
+                rc->cost[v] = cost;
+                rc->prev[v] = u;
+                rc->dist[v] = rc->dist[u] + routeGraph.km[k];
+                rc->key[v] = cost + scale * altPotential(table, routeGraph.nodeStation[v], end);
+                heapPush(&rc->heap, v);
+            }
+        }
+    }
+
+    return copyRoutePath(ctx, rc, start, end, source, sink);
+}
+
+// ---------------------- 최소 요금 (요금 구간 라벨 탐색) ----------------------
+
+// 요금은 총 거리로만 정해지므로 거리를 라벨에 자원으로 들고 다니고, 요금은 도착역에서 한 번만 계산한다.
+// 1) 도착 노드에서 거꾸로 최단 거리(미터)를 구해 최소 요금과 그 요금 구간의 끝 B를 정하고
+// 2) 총 거리가 B 이하인 경로 중 가장 빠른 경로를 (시간, 거리) 라벨 탐색으로 찾는다.
+// 라벨은 시간 순서로 확정되므로, 노드마다 지금까지 확정된 라벨의 최소 거리보다 짧은 라벨만 살아남는다
+typedef struct FareLabels {
+    int capacity;
+    int count;
+    int* node;
+    int* meters;
+    int* prev;       // 이전 라벨 (-1: 출발)
+    int* edge;       // 이 라벨로 올 때 지난 노선 그래프 간선
+    float* time;     // 힙 키
+    int nodeCapacity;
+    int* bestMeters; // 노드에서 확정된 라벨의 최소 거리 (routeContext의 seen 세대로 초기화 여부 판단)
+    int* remaining;  // 도착 노드까지 남은 최소 거리 (backwardContext에서 확정된 노드만 유효)
+    IndexedHeap heap;
+} FareLabels;
+
+FareLabels fareLabels;
+
+int pushFareLabel(FareLabels* fl, int v, int meters, float time, int prev, int edge) {
+    if (fl->count == fl->capacity) {
+        int capacity = fl->capacity ? fl->capacity * 2 : 1024;
+        fl->node = (int*)realloc(fl->node, sizeof(int) * capacity);
+        fl->meters = (int*)realloc(fl->meters, sizeof(int) * capacity);
+        fl->prev = (int*)realloc(fl->prev, sizeof(int) * capacity);
+        fl->edge = (int*)realloc(fl->edge, sizeof(int) * capacity);
+        fl->time = (float*)realloc(fl->time, sizeof(float) * capacity);
+        heapReserve(&fl->heap, capacity, fl->capacity);
+        fl->heap.key = fl->time;
+        fl->capacity = capacity;
+    }
+    int label = fl->count++;
+    fl->node[label] = v;
+    fl->meters[label] = meters;
+    fl->prev[label] = prev;
+    fl->edge[label] = edge;
+    fl->time[label] = time;
+    fl->heap.pos[label] = -1;
+    heapPush(&fl->heap, label);
+    return label;
+}
+
+void reserveFareNodes(FareLabels* fl, int N) {
+    if (fl->nodeCapacity >= N) return;
+    fl->nodeCapacity = N;
+    fl->bestMeters = (int*)realloc(fl->bestMeters, sizeof(int) * N);
+    fl->remaining = (int*)realloc(fl->remaining, sizeof(int) * N);
+}
+
+// 도착 노드까지 남은 최소 거리. source가 확정되면 요금 구간 끝 B를 정하고, B를 넘는 노드까지는 가지 않는다.
+// 돌려주는 값은 B (닿지 않으면 -1). source가 -1이면 도착 노드에 닿는 모든 노드의 거리를 구한다
+int fareRemainingMeters(const RouteGraph* g, FareLabels* fl, SearchContext* bwd, int source, int sink) {
+    int N = g->nodeCount;
+    reserveFareNodes(fl, N);
+    reserveSearchContext(bwd, N);
+    beginSearch(bwd);
+    heapClear(&bwd->heap, bwd->cost);
+    touchStation(bwd, sink);
+    bwd->cost[sink] = 0;
+    heapPush(&bwd->heap, sink);
+
+    int limit = -1;
+    while (bwd->heap.size > 0) {
+        int u = heapPop(&bwd->heap);
+        int meters = (int)bwd->cost[u];
+        if (limit != -1 && meters > limit) break;
+        bwd->settled[u] = bwd->generation;
+        bwd->settledCount++;
+        fl->remaining[u] = meters;
+        if (u == source) limit = fareBracketLimit(meters);
+
+        for (int i = g->rOffsets[u]; i < g->rOffsets[u + 1]; i++) {
+            int v = g->rSource[i];
+            if (isSettled(bwd, v) || routeEdgeClosed(g, g->rEdge[i])) continue;
+            touchStation(bwd, v);
+            float cost = bwd->cost[u] + g->meters[g->rEdge[i]];
+            if (cost < bwd->cost[v]) {
+                bwd->cost[v] = cost;
+                heapPush(&bwd->heap, v);
+            }
+        }
+    }
+    return limit;
+}
+
+// 요금 구간 라벨 탐색 본체. 그래프와 작업 공간을 받으므로 작업 공간만 따로 주면 여러 스레드에서 같이 돈다.
+// 찾은 도착 라벨 번호를 돌려줌 (없으면 -1). settledCount에는 양쪽 탐색에서 확정한 노드 수
+int fareLabelSearch(const RouteGraph* g, FareLabels* fl, SearchContext* rc, SearchContext* bwd, int source, int sink, int* settledCount) {
+    int limit = fareRemainingMeters(g, fl, bwd, source, sink);
+    *settledCount = bwd->settledCount;
+    if (limit == -1) return -1;
+
+    reserveSearchContext(rc, g->nodeCount);
+    beginSearch(rc);
+    fl->count = 0;
+    heapClear(&fl->heap, fl->time);
+    pushFareLabel(fl, source, 0, 0.0f, -1, -1);
+
+    while (fl->heap.size > 0) {
+        int label = heapPop(&fl->heap);
+        int u = fl->node[label];
+        int meters = fl->meters[label];
+        if (rc->seen[u] == rc->generation && fl->bestMeters[u] <= meters) continue;  // 더 빠르고 짧은 라벨이 있음
+        rc->seen[u] = rc->generation;
+        fl->bestMeters[u] = meters;
+        (*settledCount)++;
+        if (u == sink) return label;
+
+        for (int k = g->offsets[u]; k < g->offsets[u + 1]; k++) {
+            int v = g->target[k];
+            if (!isSettled(bwd, v) || routeEdgeClosed(g, k)) continue;  // 도착까지 B 안에 갈 수 없는 노드, 막힌 구간
+            int next = meters + g->meters[k];
+            if (next + fl->remaining[v] > limit) continue;
+            if (rc->seen[v] == rc->generation && fl->bestMeters[v] <= next) continue;
+            pushFareLabel(fl, v, next, fl->time[label] + g->weightTime[k], label, k);
+        }
+    }
+    return -1;
+}
+
+// 최소 요금 경로 중 가장 빠른 경로. 결과는 역 단위로 ctx에 채운다
+int fareSearch(SearchContext* ctx, int start, int end) {
+    ensureRouteGraph();
+    FareLabels* fl = &fareLabels;
+    SearchContext* rc = &routeContext;
+    int settledCount;
+    int found = fareLabelSearch(&routeGraph, fl, rc, &backwardContext, departNode(start), arriveNode(end), &settledCount);
+    beginRouteResult(ctx, start, settledCount);
+    if (found == -1) return 0;
+
+    // 라벨을 거꾸로 따라가서 출발 쪽부터 옮긴다
+    int count = 0;
+    for (int label = found; fl->prev[label] != -1; label = fl->prev[label]) rc->path[count++] = label;
+    for (int i = count - 1; i >= 0; i--) {
+        int label = rc->path[i];
+        addRouteStep(ctx, fl->node[fl->prev[label]], fl->node[label], routeGraph.km[fl->edge[label]]);
+    }
+    ctx->cost[end] = fl->time[found];
+    return 1;
+}
+
+// ---------------------- 파레토 경로 (시간, 환승, 요금) ----------------------
+
+// 시간, 환승 횟수, 요금을 한 번의 탐색으로 비교한다. 라벨은 시간 순서로 확정하고, 노드마다 확정된 라벨 묶음(bag)을 두어
+// 환승과 거리가 모두 같거나 많은 라벨은 버린다. 요금은 총 거리로만 정해지므로 중간 노드에서는 거리로 비교하고,
+// 도착 노드의 라벨과는 요금으로 비교해서 더 나은 결과를 만들 수 없는 라벨을 일찍 버린다.
+// 노드마다 PARETO_MAX_LABELS개까지만 남겨서 큰 노선도에서도 대화형으로 쓸 수 있게 한다 (넘치면 결과가 일부 빠질 수 있음)
+#define PARETO_MAX_LABELS 8
+#define PARETO_MAX_RESULTS 16
+
+typedef struct ParetoLabels {
+    int capacity;
+    int count;
+    int* node;
+    int* transfers;
+    int* meters;
+    int* prev;       // 이전 라벨 (-1: 출발)
+    int* edge;       // 이 라벨로 올 때 지난 노선 그래프 간선
+    int* bagNext;    // 같은 노드에서 확정된 다음 라벨
+    float* time;     // 힙 키
+    int nodeCapacity;
+    int* bagHead;    // 노드 -> 확정된 라벨 목록 (routeContext의 seen 세대로 초기화 여부 판단)
+    int* bagSize;
+    IndexedHeap heap;
+} ParetoLabels;
+
+ParetoLabels paretoLabels;
+
+int pushParetoLabel(ParetoLabels* pl, int v, float time, int transfers, int meters, int prev, int edge) {
+    if (pl->count == pl->capacity) {
+        int capacity = pl->capacity ? pl->capacity * 2 : 1024;
+        pl->node = (int*)realloc(pl->node, sizeof(int) * capacity);
+        pl->transfers = (int*)realloc(pl->transfers, sizeof(int) * capacity);
+        pl->meters = (int*)realloc(pl->meters, sizeof(int) * capacity);
+        pl->prev = (int*)realloc(pl->prev, sizeof(int) * capacity);
+        pl->edge = (int*)realloc(pl->edge, sizeof(int) * capacity);
+        pl->bagNext = (int*)realloc(pl->bagNext, sizeof(int) * capacity);
+        pl->time = (float*)realloc(pl->time, sizeof(float) * capacity);
+        heapReserve(&pl->heap, capacity, pl->capacity);
+        pl->heap.key = pl->time;
+        pl->capacity = capacity;
+    }
+    int label = pl->count++;
+    pl->node[label] = v;
+    pl->time[label] = time;
+    pl->transfers[label] = transfers;
+    pl->meters[label] = meters;
+    pl->prev[label] = prev;
+    pl->edge[label] = edge;
+    pl->bagNext[label] = -1;
+    pl->heap.pos[label] = -1;
+    heapPush(&pl->heap, label);
+    return label;
+}
+
+// 노드 v에 확정된 라벨 중 (transfers, meters)를 지배하는 것이 있는지. 확정된 라벨은 시간이 같거나 빠르다
+int paretoDominated(const ParetoLabels* pl, const SearchContext* rc, int v, int transfers, int meters) {
+    if (rc->seen[v] != rc->generation) return 0;
+    for (int label = pl->bagHead[v]; label != -1; label = pl->bagNext[label])
+        if (pl->transfers[label] <= transfers && pl->meters[label] <= meters) return 1;
+    return 0;
+}
+
+// 묶음이 가득 찼을 때도 환승이나 거리가 묶음의 최솟값보다 작은 라벨은 받는다.
+// 그래서 최소 시간(처음 확정된 라벨), 최소 환승, 최소 요금 경로는 상한과 상관없이 항상 찾는다
+int paretoImproves(const ParetoLabels* pl, int v, int transfers, int meters) {
+    int minTransfers = INT_MAX, minMeters = INT_MAX;
+    for (int label = pl->bagHead[v]; label != -1; label = pl->bagNext[label]) {
+        if (pl->transfers[label] < minTransfers) minTransfers = pl->transfers[label];
+        if (pl->meters[label] < minMeters) minMeters = pl->meters[label];
+    }
+    return transfers < minTransfers || meters < minMeters;
+}
+
+// 도착 노드의 라벨 중 (transfers, 요금)을 지배하는 것이 있는지. 시간, 환승은 가면서 줄지 않고
+// 거리는 도착까지 남은 최소 거리(meters에 더해서 넘김)만큼은 늘어나므로 버려도 된다
+int paretoDominatedAtSink(const ParetoLabels* pl, const SearchContext* rc, int sink, int transfers, int meters) {
+    if (rc->seen[sink] != rc->generation) return 0;
+    int fare = fareForMeters(meters);
+    for (int label = pl->bagHead[sink]; label != -1; label = pl->bagNext[label])
+        if (pl->transfers[label] <= transfers && fareForMeters(pl->meters[label]) <= fare) return 1;
+    return 0;
+}
+
+// a가 (시간, 환승, 요금) 모두 b보다 나쁘지 않은지
+int paretoNoWorse(const ParetoLabels* pl, int a, int b) {
+    return pl->time[a] <= pl->time[b] && pl->transfers[a] <= pl->transfers[b]
+        && fareForMeters(pl->meters[a]) <= fareForMeters(pl->meters[b]);
+}
+
+// start -> end의 파레토 경로를 시간 순서로 results에 담고 개수를 돌려준다 (도착 노드의 라벨 번호).
+// 경로가 maxResults개보다 많으면 최소 시간, 최소 환승, 최소 요금 경로를 남기고 나머지를 시간 순서로 채운다
+int paretoSearch(int start, int end, int* results, int maxResults, int* settledCount) {
+    ensureRouteGraph();
+    ParetoLabels* pl = &paretoLabels;
+    SearchContext* rc = &routeContext;
+    int N = routeGraph.nodeCount;
+    if (pl->nodeCapacity < N) {
+        pl->nodeCapacity = N;
+        pl->bagHead = (int*)realloc(pl->bagHead, sizeof(int) * N);
+        pl->bagSize = (int*)realloc(pl->bagSize, sizeof(int) * N);
+    }
+    int source = departNode(start), sink = arriveNode(end);
+    *settledCount = 0;
+
+    // 도착까지 남은 최소 거리로 요금 하한을 잡는다. 도착에 닿지 않는 노드는 backwardContext에서 확정되지 않는다
+    SearchContext* bwd = &backwardContext;
+    fareRemainingMeters(&routeGraph, &fareLabels, &backwardContext, -1, sink);
+    const int* remaining = fareLabels.remaining;
+    if (!isSettled(bwd, source)) return 0;
+
+    reserveSearchContext(rc, N);
+    beginSearch(rc);
+    pl->count = 0;
+    heapClear(&pl->heap, pl->time);
+    pushParetoLabel(pl, source, 0.0f, 0, 0, -1, -1);
+    while (pl->heap.size > 0) {
+        int label = heapPop(&pl->heap);
+        int u = pl->node[label];
+        int transfers = pl->transfers[label], meters = pl->meters[label];
+        if (paretoDominated(pl, rc, u, transfers, meters)) continue;
+        if (paretoDominatedAtSink(pl, rc, sink, transfers, meters + remaining[u])) continue;
+        if (rc->seen[u] != rc->generation) {
+            rc->seen[u] = rc->generation;
+            pl->bagHead[u] = -1;
+            pl->bagSize[u] = 0;
+        }
+        if (pl->bagSize[u] >= PARETO_MAX_LABELS && !paretoImproves(pl, u, transfers, meters)) continue;
+        pl->bagNext[label] = pl->bagHead[u];
+        pl->bagHead[u] = label;
+        pl->bagSize[u]++;
+        (*settledCount)++;
+
+        if (u == sink) continue;
+
+        for (int k = routeGraph.offsets[u]; k < routeGraph.offsets[u + 1]; k++) {
+            int v = routeGraph.target[k];
+            int nextTransfers = transfers + (routeGraph.kind[k] == ROUTE_TRANSFER);
+            int nextMeters = meters + routeGraph.meters[k];
+            if (!isSettled(bwd, v) || routeEdgeClosed(&routeGraph, k)) continue;
+            if (paretoDominated(pl, rc, v, nextTransfers, nextMeters)) continue;
+            if (paretoDominatedAtSink(pl, rc, sink, nextTransfers, nextMeters + remaining[v])) continue;
+            pushParetoLabel(pl, v, pl->time[label] + routeGraph.weightTime[k], nextTransfers, nextMeters, label, k);
+        }
+    }
+
+    if (rc->seen[sink] != rc->generation) return 0;
+
+    // 도착 노드의 묶음은 최근 것이 앞에 있으므로 뒤집어서 시간 순서로 모은다.
+    // 시간이 같은 라벨은 나중에 확정된 쪽이 더 나을 수 있어서 서로 한 번 더 거른다 (완전히 같으면 앞의 것만)
+    int* front = rc->path;
+    int count = 0;
+    for (int label = pl->bagHead[sink]; label != -1; label = pl->bagNext[label]) front[count++] = label;
+    for (int i = 0; i < count / 2; i++) {
+        int t = front[i];
+        front[i] = front[count - 1 - i];
+        front[count - 1 - i] = t;
+    }
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        int dominated = 0;
+        for (int j = 0; j < count && !dominated; j++)
+            dominated = j != i && paretoNoWorse(pl, front[j], front[i]) && (j < i || !paretoNoWorse(pl, front[i], front[j]));
+        if (!dominated) front[kept++] = front[i];
+    }
+    count = kept;
+    if (count <= maxResults) {
+        memcpy(results, front, sizeof(int) * count);
+        return count;
+    }
+
+    // 너무 많으면 세 가지 최솟값은 꼭 남긴다 (최소 시간은 맨 앞)
+    int fewestTransfers = 0, cheapest = 0;
+    for (int i = 1; i < count; i++) {
+        if (pl->transfers[front[i]] < pl->transfers[front[fewestTransfers]]) fewestTransfers = i;
+        if (pl->meters[front[i]] < pl->meters[front[cheapest]]) cheapest = i;
+    }
+    int reserved = (fewestTransfers != 0) + (cheapest != 0 && cheapest != fewestTransfers);
+    int found = 0;
+    for (int i = 0; i < count && found < maxResults; i++) {
+        int must = i == 0 || i == fewestTransfers || i == cheapest;
+        if (!must && found >= maxResults - reserved) continue;
+        if (must && i != 0) reserved--;
+        results[found++] = front[i];
+    }
+    return found;
+}
+
+// 도착 노드의 라벨 하나를 역 단위 경로로 ctx에 옮긴다
+void copyParetoPath(SearchContext* ctx, int start, int end, int found, int settledCount) {
+    ParetoLabels* pl = &paretoLabels;
+    SearchContext* rc = &routeContext;
+    beginRouteResult(ctx, start, settledCount);
+    int count = 0;
+    for (int label = found; pl->prev[label] != -1; label = pl->prev[label]) rc->path[count++] = label;
+    for (int i = count - 1; i >= 0; i--) {
+        int label = rc->path[i];
+        addRouteStep(ctx, pl->node[pl->prev[label]], pl->node[label], routeGraph.km[pl->edge[label]]);
+    }
+    ctx->cost[end] = pl->time[found];
+}
+
+// ---------------------- 시간표 (RAPTOR) ----------------------
+
+// 호선마다 간선을 겹치지 않는 역 순서(노선)로 나누고, 노선마다 양방향 열차를 배차표대로 만든다.
+// 노선은 가장 긴 경로부터 떼어 내므로 본선이 한 노선이 되고 지선은 분기역에서 갈아타는 노선이 된다.
+// 정류장은 노선 그래프의 (역, 호선) 노드이고 같은 역 다른 호선 사이 환승 시간은 노선 그래프의 환승 간선을 쓴다.
+// 탐색은 RAPTOR: 라운드 k에서 k번째로 탈 열차를 노선 단위로 훑는다
+#define RAPTOR_MAX_ROUNDS 8  // 최대 탑승 횟수
+#define NO_TIME INT_MAX
+
+typedef struct TimetableRoute {
+    int line;
+    int firstStop;  // routeStops/stopSeconds/stopKm 안의 시작 위치
+    int stopCount;
+    int firstTrip;  // 열차 t가 정류장 i에 닿는 시각은 stopTimes[firstTrip + t * stopCount + i]
+    int tripCount;
+} TimetableRoute;
+
+typedef struct Timetable {
+    int graphVersion;      // 만들 때의 routeGraph.version
+    int timetableVersion;  // 만들 때의 배차 버전
+    int metric;            // 정류장 시각에 반영한 구간 통제 (routeGraph.metric)
+    int routeCount;
+    int routeCapacity;
+    TimetableRoute* routes;
+    int stopCount;
+    int stopCapacity;
+    int* routeStops;       // 노선 그래프 (역, 호선) 노드
+    int* stopSeconds;      // 노선 첫 정류장부터 걸리는 시간 (초)
+    float* stopKm;         // 노선 첫 정류장부터 거리
+    char* stopClosed;      // 1이면 앞 정류장에서 이 정류장으로 가는 구간이 운행 중단 (열차가 여기서 끊김)
+    int timeCount;
+    int timeCapacity;
+    int* stopTimes;
+    int* stopRouteOffsets; // 노드 n을 지나는 노선은 [stopRouteOffsets[n], stopRouteOffsets[n + 1])
+    int* stopRoutes;       // 노선 번호
+    int* stopRouteIndex;   // 그 노선 안에서 몇 번째 정류장인지
+} Timetable;
+
+Timetable timetable;
+
+// 노선 그래프에서 u -> v 운행 간선 (없으면 -1)
+int rideEdge(int u, int v) {
+    for (int k = routeGraph.offsets[u]; k < routeGraph.offsets[u + 1]; k++)
+        if (routeGraph.target[k] == v && routeGraph.kind[k] == ROUTE_RIDE) return k;
+    return -1;
+}
+
+int compareInt(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// 호선 line의 종점 출발 시각 목록 (정렬, 중복 제거). departures는 호출한 쪽이 free
+int lineDepartures(int line, int** departures) {
+    int count = 0, capacity = 256;
+    int* list = (int*)malloc(sizeof(int) * capacity);
+    int found = 0;
+    for (int pass = 0; pass < 2 && !found; pass++) {
+        for (int b = 0; b < (pass == 0 ? headwayBandCount : 1); b++) {
+            HeadwayBand band = { line, DEFAULT_FIRST_TRAIN, DEFAULT_LAST_TRAIN, DEFAULT_HEADWAY };
+            if (pass == 0) {
+                if (headwayBands[b].line != line) continue;
+                band = headwayBands[b];
+            }
+            found = 1;
+            for (int t = band.from; t <= band.to; t += band.headway) {
+                if (count == capacity) {
+                    capacity *= 2;
+                    list = (int*)realloc(list, sizeof(int) * capacity);
+                }
+                list[count++] = t;
+                if (band.headway <= 0) break;
+            }
+        }
+    }
+    qsort(list, count, sizeof(int), compareInt);
+    int kept = 0;
+    for (int i = 0; i < count; i++)
+        if (kept == 0 || list[kept - 1] != list[i]) list[kept++] = list[i];
+    *departures = list;
+    return kept;
+}
+
+// 노선의 구간 시간(구간 통제 반영)으로 정류장 시각을 채움. 열차마다 첫 정류장 출발 시각은 그대로 둔다.
+// 운행 중단 구간은 원래 시간으로 두고 stopClosed만 표시한다 (그 구간을 건너는 열차는 탐색에서 끊는다)
+void timeTimetableRoute(const TimetableRoute* route) {
+    Timetable* tt = &timetable;
+    int count = route->stopCount;
+    const int* stops = &tt->routeStops[route->firstStop];
+    int* seconds = &tt->stopSeconds[route->firstStop];
+    float* km = &tt->stopKm[route->firstStop];
+    char* closed = &tt->stopClosed[route->firstStop];
+    for (int i = 0; i < count; i++) {
+        seconds[i] = 0;
+        km[i] = 0.0f;
+        closed[i] = 0;
+        if (i == 0) continue;
+        int k = rideEdge(stops[i - 1], stops[i]);
+        if (k == -1) k = rideEdge(stops[i], stops[i - 1]);  // 한쪽 방향만 적힌 구간
+        closed[i] = routeEdgeClosed(&routeGraph, k);
+        float minutes = closed[i] ? routeGraph.baseTime[k] : routeGraph.weightTime[k];
+        seconds[i] = seconds[i - 1] + (int)(minutes * 60.0f + 0.5f);
+        km[i] = km[i - 1] + routeGraph.km[k];
+    }
+    for (int t = 0; t < route->tripCount; t++) {
+        int* row = &tt->stopTimes[route->firstTrip + t * count];
+        for (int i = 1; i < count; i++) row[i] = row[0] + seconds[i];
+    }
+}
+
+// 노드 순서 nodes로 노선 하나를 추가하고 열차를 채운다
+void addTimetableRoute(const int* nodes, int count, int line, const int* departures, int departureCount) {
+    Timetable* tt = &timetable;
+    if (tt->routeCount == tt->routeCapacity) {
+        tt->routeCapacity = tt->routeCapacity ? tt->routeCapacity * 2 : 32;
+        tt->routes = (TimetableRoute*)realloc(tt->routes, sizeof(TimetableRoute) * tt->routeCapacity);
+    }
+    if (tt->stopCount + count > tt->stopCapacity) {
+        while (tt->stopCount + count > tt->stopCapacity) tt->stopCapacity = tt->stopCapacity ? tt->stopCapacity * 2 : 256;
+        tt->routeStops = (int*)realloc(tt->routeStops, sizeof(int) * tt->stopCapacity);
+        tt->stopSeconds = (int*)realloc(tt->stopSeconds, sizeof(int) * tt->stopCapacity);
+        tt->stopKm = (float*)realloc(tt->stopKm, sizeof(float) * tt->stopCapacity);
+        tt->stopClosed = (char*)realloc(tt->stopClosed, sizeof(char) * tt->stopCapacity);
+    }
+    long long times = (long long)count * departureCount;
+    if (tt->timeCount + times > tt->timeCapacity) {
+        while (tt->timeCount + times > tt->timeCapacity) tt->timeCapacity = tt->timeCapacity ? tt->timeCapacity * 2 : 4096;
+        tt->stopTimes = (int*)realloc(tt->stopTimes, sizeof(int) * tt->timeCapacity);
+    }
+
+    TimetableRoute* route = &tt->routes[tt->routeCount++];
+    route->line = line;
+    route->firstStop = tt->stopCount;
+    route->stopCount = count;
+    route->firstTrip = tt->timeCount;
+    route->tripCount = departureCount;
+
+    for (int i = 0; i < count; i++) tt->routeStops[route->firstStop + i] = nodes[i];
+    for (int t = 0; t < departureCount; t++) tt->stopTimes[route->firstTrip + t * count] = departures[t];
+    tt->stopCount += count;
+    tt->timeCount += (int)times;
+    timeTimetableRoute(route);
+}
+
+// 아직 노선에 넣지 않은 운행 간선만 따라가는 BFS. 가장 먼 노드를 돌려주고 parent/parentEdge에 경로를 남긴다
+// (같은 호선에 같은 구간이 두 번 적히면 u -> v 운행 간선이 여러 개라 실제로 지난 간선을 기억해야 한다)
+int farthestRideNode(int source, const char* used, int* parent, int* parentEdge, int* queue, int* stamp, int generation) {
+    int head = 0, tail = 0, last = source;
+    queue[tail++] = source;
+    stamp[source] = generation;
+    parent[source] = -1;
+    parentEdge[source] = -1;
+    while (head < tail) {
+        int u = queue[head++];
+        last = u;
+        for (int k = routeGraph.offsets[u]; k < routeGraph.offsets[u + 1]; k++) {
+            if (routeGraph.kind[k] != ROUTE_RIDE || used[k]) continue;
+            int v = routeGraph.target[k];
+            if (stamp[v] == generation) continue;
+            stamp[v] = generation;
+            parent[v] = u;
+            parentEdge[v] = k;
+            queue[tail++] = v;
+        }
+    }
+    return last;
+}
+
+// 노선에 아직 넣지 않은 u -> v 운행 간선 (없으면 -1)
+int openRideEdge(const char* used, int u, int v) {
+    for (int k = routeGraph.offsets[u]; k < routeGraph.offsets[u + 1]; k++)
+        if (routeGraph.target[k] == v && routeGraph.kind[k] == ROUTE_RIDE && !used[k]) return k;
+    return -1;
+}
+
+// u에서 나가는 운행 간선 k와 아직 안 쓴 반대 방향 간선 하나를 노선에 넣은 것으로 표시. 새로 표시한 개수를 돌려준다
+int markRideUsed(char* used, int u, int k) {
+    if (k == -1 || used[k]) return 0;
+    used[k] = 1;
+    int reverse = openRideEdge(used, routeGraph.target[k], u);
+    if (reverse != -1) used[reverse] = 1;
+    return 1 + (reverse != -1);
+}
+
+void buildTimetable() {
+    ensureRouteGraph();
+    if (!timetableLoaded) loadTimetable(TIMETABLE_FILE);
+    Timetable* tt = &timetable;
+    tt->routeCount = 0;
+    tt->stopCount = 0;
+    tt->timeCount = 0;
+
+    int R = routeGraph.routeNodeCount;
+    int M = routeGraph.edgeCount;
+    char* used = (char*)calloc(M ? M : 1, 1);
+    int* parent = (int*)malloc(sizeof(int) * (R ? R : 1));
+    int* parentEdge = (int*)malloc(sizeof(int) * (R ? R : 1));
+    int* queue = (int*)malloc(sizeof(int) * (R ? R : 1));
+    int* stamp = (int*)calloc(R ? R : 1, sizeof(int));
+    int* path = (int*)malloc(sizeof(int) * (2 * R + 1));
+    int generation = 0;
+
+    // 남은 운행 간선이 있는 노드에서 가장 먼 노드 a를 찾고, a에서 가장 먼 노드 b까지를 노선 하나로 뗀다
+    for (int u = 0; u < R; u++) {
+        for (;;) {
+            int open = 0;
+            for (int k = routeGraph.offsets[u]; k < routeGraph.offsets[u + 1] && !open; k++)
+                open = routeGraph.kind[k] == ROUTE_RIDE && !used[k];
+            if (!open) break;
+
+            int a = farthestRideNode(u, used, parent, parentEdge, queue, stamp, ++generation);
+            int b = farthestRideNode(a, used, parent, parentEdge, queue, stamp, ++generation);
+            int count = 0, marked = 0;
+            for (int v = b; v != -1; v = parent[v]) {
+                path[count++] = v;
+                if (parent[v] != -1) marked += markRideUsed(used, parent[v], parentEdge[v]);
+            }
+            if (marked == 0) {
+                // a에서 더 나갈 곳이 없음 (한쪽 방향만 적힌 구간의 끝): u의 남은 간선 하나만 노선으로 뗀다.
+                // 자기 자신으로 돌아오는 간선만 남았으면 노선으로 만들 수 없으니 버려야 멈추지 않는다
+                for (int k = routeGraph.offsets[u]; k < routeGraph.offsets[u + 1] && !marked; k++) {
+                    if (routeGraph.kind[k] != ROUTE_RIDE || used[k]) continue;
+                    if (routeGraph.target[k] == u) {
+                        used[k] = 1;
+                        continue;
+                    }
+                    a = u;
+                    b = routeGraph.target[k];
+                    path[0] = b;
+                    path[1] = a;
+                    count = 2;
+                    marked = markRideUsed(used, u, k);
+                }
+                if (!marked) continue;
+            }
+            for (int i = 0; i < count / 2; i++) {
+                int t = path[i];
+                path[i] = path[count - 1 - i];
+                path[count - 1 - i] = t;
+            }
+
+            // 양 끝이 바로 이어지면 순환선: 한 바퀴 더 이어 붙여 시작점을 지나는 이동도 갈아타지 않게 한다
+            int closing = count >= 3 ? openRideEdge(used, b, a) : -1;
+            if (closing != -1) {
+                markRideUsed(used, b, closing);
+                for (int i = 0; i < count - 1; i++) path[count + i] = path[i];
+                count = 2 * count - 1;
+            }
+
+            int line = routeGraph.nodeLine[a];
+            int* departures;
+            int departureCount = lineDepartures(line, &departures);
+            addTimetableRoute(path, count, line, departures, departureCount);
+            for (int i = 0; i < count / 2; i++) {
+                int t = path[i];
+                path[i] = path[count - 1 - i];
+                path[count - 1 - i] = t;
+            }
+            addTimetableRoute(path, count, line, departures, departureCount);
+            free(departures);
+        }
+    }
+    free(used);
+    free(parent);
+    free(parentEdge);
+    free(queue);
+    free(stamp);
+    free(path);
+
+    // 노드별로 지나는 노선 목록 (CSR)
+    tt->stopRouteOffsets = (int*)realloc(tt->stopRouteOffsets, sizeof(int) * (R + 1));
+    tt->stopRoutes = (int*)realloc(tt->stopRoutes, sizeof(int) * (tt->stopCount ? tt->stopCount : 1));
+    tt->stopRouteIndex = (int*)realloc(tt->stopRouteIndex, sizeof(int) * (tt->stopCount ? tt->stopCount : 1));
+    memset(tt->stopRouteOffsets, 0, sizeof(int) * (R + 1));
+    for (int i = 0; i < tt->stopCount; i++) tt->stopRouteOffsets[tt->routeStops[i] + 1]++;
+    for (int n = 0; n < R; n++) tt->stopRouteOffsets[n + 1] += tt->stopRouteOffsets[n];
+    for (int r = 0; r < tt->routeCount; r++) {
+        const TimetableRoute* route = &tt->routes[r];
+        for (int i = 0; i < route->stopCount; i++) {
+            int n = tt->routeStops[route->firstStop + i];
+            int slot = tt->stopRouteOffsets[n]++;
+            tt->stopRoutes[slot] = r;
+            tt->stopRouteIndex[slot] = i;
+        }
+    }
+    for (int n = R; n > 0; n--) tt->stopRouteOffsets[n] = tt->stopRouteOffsets[n - 1];
+    tt->stopRouteOffsets[0] = 0;
+
+    tt->graphVersion = routeGraph.version;
+    tt->timetableVersion = timetableVersion;
+    tt->metric = routeGraph.metric;
+}
+
+void ensureTimetable() {
+    ensureRouteGraph();
+    if (!timetableLoaded) loadTimetable(TIMETABLE_FILE);
+    if (timetable.routes == NULL || timetable.graphVersion != routeGraph.version || timetable.timetableVersion != timetableVersion) {
+        buildTimetable();
+    }
+    else if (timetable.metric != routeGraph.metric) {
+        // 구간 통제만 바뀜: 노선 분할은 그대로 두고 정류장 시각만 다시 채운다
+        for (int r = 0; r < timetable.routeCount; r++) timeTimetableRoute(&timetable.routes[r]);
+        timetable.metric = routeGraph.metric;
+    }
+}
+
+// 라운드별 도착 시각과 어떻게 왔는지. [round * nodeCount + n]
+typedef struct RaptorState {
+    int nodeCapacity;
+    int routeCapacity;
+    int nodeCount;
+    int* arrival;    // NO_TIME: 아직 못 감
+    int* via;        // 타고 온 노선 (-1: 출발역, -2: 같은 역 환승)
+    int* viaTrip;
+    int* viaFrom;    // 노선이면 탄 정류장 위치, 환승이면 이전 노드
+    int* best;       // 노드별로 모든 라운드 중 가장 이른 도착
+    char* marked;
+    int* markedList;
+    int markedCount;
+    int* routeFrom;  // 이번 라운드에 노선을 훑기 시작할 정류장 위치 (-1: 훑지 않음)
+    int* routeQueue;
+} RaptorState;
+
+RaptorState raptorState;
+
+typedef struct RaptorLeg {
+    int route;
+    int trip;
+    int board;   // 탄 정류장 위치
+    int alight;  // 내린 정류장 위치
+} RaptorLeg;
+
+// 라벨을 모두 지운다 (프로필 탐색은 출발 시각을 바꿔 가며 지우지 않고 이어서 돈다)
+void resetRaptorState(RaptorState* rs) {
+    int N = routeGraph.routeNodeCount;
+    int routes = timetable.routeCount;
+    int rounds = RAPTOR_MAX_ROUNDS + 1;
+    if (N > rs->nodeCapacity) {
+        rs->nodeCapacity = N;
+        rs->arrival = (int*)realloc(rs->arrival, sizeof(int) * rounds * N);
+        rs->via = (int*)realloc(rs->via, sizeof(int) * rounds * N);
+        rs->viaTrip = (int*)realloc(rs->viaTrip, sizeof(int) * rounds * N);
+        rs->viaFrom = (int*)realloc(rs->viaFrom, sizeof(int) * rounds * N);
+        rs->best = (int*)realloc(rs->best, sizeof(int) * N);
+        rs->marked = (char*)realloc(rs->marked, N);
+        rs->markedList = (int*)realloc(rs->markedList, sizeof(int) * N);
+    }
+    if (routes > rs->routeCapacity) {
+        rs->routeCapacity = routes;
+        rs->routeFrom = (int*)realloc(rs->routeFrom, sizeof(int) * routes);
+        rs->routeQueue = (int*)realloc(rs->routeQueue, sizeof(int) * routes);
+    }
+    rs->nodeCount = N;
+    for (int i = 0; i < rounds * N; i++) rs->arrival[i] = NO_TIME;
+    for (int n = 0; n < N; n++) {
+        rs->best[n] = NO_TIME;
+        rs->marked[n] = 0;
+    }
+    for (int r = 0; r < routes; r++) rs->routeFrom[r] = -1;
+    rs->markedCount = 0;
+}
+
+void raptorMark(RaptorState* rs, int n) {
+    if (rs->marked[n]) return;
+    rs->marked[n] = 1;
+    rs->markedList[rs->markedCount++] = n;
+}
+
+// 라운드 k의 노드 n을 갱신
+void raptorSet(RaptorState* rs, int k, int n, int time, int via, int trip, int from) {
+    int slot = k * rs->nodeCount + n;
+    rs->arrival[slot] = time;
+    rs->via[slot] = via;
+    rs->viaTrip[slot] = trip;
+    rs->viaFrom[slot] = from;
+    if (time < rs->best[n]) rs->best[n] = time;
+    raptorMark(rs, n);
+}
+
+// 노선 r의 정류장 i에서 time 이후 가장 먼저 떠나는 열차 ([0, limit) 안에서, 없으면 -1)
+int earliestTrip(const TimetableRoute* route, int i, int time, int limit) {
+    const int* times = &timetable.stopTimes[route->firstTrip + i];
+    int low = 0, high = limit;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (times[mid * route->stopCount] >= time) high = mid;
+        else low = mid + 1;
+    }
+    return low < limit ? low : -1;
+}
+
+int stationArrival(const RaptorState* rs, int station) {
+    int best = NO_TIME;
+    for (int n = routeGraph.stationFirst[station]; n < routeGraph.stationFirst[station + 1]; n++)
+        if (rs->best[n] < best) best = rs->best[n];
+    return best;
+}
+
+// departure에 start역에서 출발해 각 노드에 가장 일찍 닿는 시각을 라운드별로 구한다.
+// 이미 있는 라벨보다 늦은 도착은 버리므로, 늦은 출발부터 차례로 부르면 앞 결과를 그대로 가지치기에 쓴다.
+// 돌려주는 값은 end역 도착 시각 (못 가면 NO_TIME)
+int raptorSearch(RaptorState* rs, int start, int end, int departure) {
+    const Timetable* tt = &timetable;
+    int N = rs->nodeCount;
+    for (int n = routeGraph.stationFirst[start]; n < routeGraph.stationFirst[start + 1]; n++)
+        if (departure < rs->arrival[n]) raptorSet(rs, 0, n, departure, -1, -1, -1);
+    int target = stationArrival(rs, end);
+
+    for (int k = 1; k <= RAPTOR_MAX_ROUNDS && rs->markedCount > 0; k++) {
+        // 앞 라운드보다 나쁜 라벨은 앞 라운드 것으로 (k번 이하로 타고 닿는 가장 이른 시각)
+        int* previous = &rs->arrival[(k - 1) * N];
+        int* current = &rs->arrival[k * N];
+        for (int n = 0; n < N; n++) {
+            if (previous[n] >= current[n]) continue;
+            current[n] = previous[n];
+            rs->via[k * N + n] = rs->via[(k - 1) * N + n];
+            rs->viaTrip[k * N + n] = rs->viaTrip[(k - 1) * N + n];
+            rs->viaFrom[k * N + n] = rs->viaFrom[(k - 1) * N + n];
+        }
+
+        // 표시된 노드를 지나는 노선을 모아서, 노선마다 가장 앞쪽 표시된 정류장부터 훑는다
+        int queued = 0;
+        for (int m = 0; m < rs->markedCount; m++) {
+            int p = rs->markedList[m];
+            rs->marked[p] = 0;
+            for (int j = tt->stopRouteOffsets[p]; j < tt->stopRouteOffsets[p + 1]; j++) {
+                int r = tt->stopRoutes[j], i = tt->stopRouteIndex[j];
+                if (rs->routeFrom[r] == -1) rs->routeQueue[queued++] = r;
+                if (rs->routeFrom[r] == -1 || i < rs->routeFrom[r]) rs->routeFrom[r] = i;
+            }
+        }
+        rs->markedCount = 0;
+
+        for (int q = 0; q < queued; q++) {
+            int r = rs->routeQueue[q];
+            const TimetableRoute* route = &tt->routes[r];
+            const int* stops = &tt->routeStops[route->firstStop];
+            int trip = -1, board = -1;
+            for (int i = rs->routeFrom[r]; i < route->stopCount; i++) {
+                int p = stops[i];
+                if (tt->stopClosed[route->firstStop + i]) trip = -1;  // 운행 중단 구간: 타고 온 열차는 여기로 못 온다
+                if (trip != -1) {
+                    int time = tt->stopTimes[route->firstTrip + trip * route->stopCount + i];
+                    if (time < rs->best[p] && time < target) {
+                        raptorSet(rs, k, p, time, r, trip, board);
+                        if (routeGraph.nodeStation[p] == end) target = time;
+                    }
+                }
+                // 앞 라운드에 여기 닿았으면 더 이른 열차를 탈 수 있는지 본다
+                int ready = previous[p];
+                if (ready == NO_TIME) continue;
+                if (trip != -1 && ready > tt->stopTimes[route->firstTrip + trip * route->stopCount + i]) continue;
+                int earlier = earliestTrip(route, i, ready, trip == -1 ? route->tripCount : trip + 1);
+                if (earlier != -1 && earlier != trip) {
+                    trip = earlier;
+                    board = i;
+                }
+            }
+            rs->routeFrom[r] = -1;
+        }
+
+        // 같은 역 다른 호선으로 갈아타기 (이번 라운드에 새로 닿은 노드에서만)
+        int arrived = rs->markedCount;
+        for (int m = 0; m < arrived; m++) {
+            int p = rs->markedList[m];
+            for (int e = routeGraph.offsets[p]; e < routeGraph.offsets[p + 1]; e++) {
+                if (routeGraph.kind[e] != ROUTE_TRANSFER) continue;
+                int q = routeGraph.target[e];
+                int time = current[p] + (int)(routeGraph.weightTime[e] * 60.0f + 0.5f);
+                if (time < rs->best[q] && time < target) {
+                    raptorSet(rs, k, q, time, -2, -1, p);
+                    if (routeGraph.nodeStation[q] == end) target = time;
+                }
+            }
+        }
+    }
+    for (int m = 0; m < rs->markedCount; m++) rs->marked[rs->markedList[m]] = 0;
+    rs->markedCount = 0;
+    return stationArrival(rs, end);
+}
+
+// end역에 가장 일찍, 그중 가장 적게 타고 닿는 라벨을 따라 탄 열차 목록을 만든다 (개수를 돌려줌)
+int raptorJourney(const RaptorState* rs, int end, RaptorLeg* legs, int maxLegs) {
+    int N = rs->nodeCount;
+    int arrival = stationArrival(rs, end);
+    if (arrival == NO_TIME) return 0;
+    int round = -1, node = -1;
+    for (int k = 0; k <= RAPTOR_MAX_ROUNDS && round == -1; k++)
+        for (int n = routeGraph.stationFirst[end]; n < routeGraph.stationFirst[end + 1]; n++)
+            if (rs->arrival[k * N + n] == arrival) {
+                round = k;
+                node = n;
+                break;
+            }
+
+    int count = 0, steps = 0;
+    while (round > 0 && steps++ < (RAPTOR_MAX_ROUNDS + 1) * 4) {
+        int slot = round * N + node;
+        int via = rs->via[slot];
+        if (via == -1) break;
+        if (via == -2) {
+            node = rs->viaFrom[slot];
+            continue;
+        }
+        const TimetableRoute* route = &timetable.routes[via];
+        int alight = -1;
+        for (int i = rs->viaFrom[slot] + 1; i < route->stopCount; i++)
+            if (timetable.routeStops[route->firstStop + i] == node
+                && timetable.stopTimes[route->firstTrip + rs->viaTrip[slot] * route->stopCount + i] == rs->arrival[slot]) {
+                alight = i;
+                break;
+            }
+        if (count < maxLegs) {
+            legs[count].route = via;
+            legs[count].trip = rs->viaTrip[slot];
+            legs[count].board = rs->viaFrom[slot];
+            legs[count].alight = alight;
+            count++;
+        }
+        node = timetable.routeStops[route->firstStop + rs->viaFrom[slot]];
+        round--;
+    }
+    for (int i = 0; i < count / 2; i++) {
+        RaptorLeg t = legs[i];
+        legs[i] = legs[count - 1 - i];
+        legs[count - 1 - i] = t;
+    }
+    return count;
+}
+
+// 탄 열차 목록을 역 단위 경로로 ctx에 옮긴다
+void copyRaptorPath(SearchContext* ctx, int start, const RaptorLeg* legs, int count) {
+    beginRouteResult(ctx, start, 0);
+    for (int l = 0; l < count; l++) {
+        const TimetableRoute* route = &timetable.routes[legs[l].route];
+        const int* stops = &timetable.routeStops[route->firstStop];
+        const float* km = &timetable.stopKm[route->firstStop];
+        for (int i = legs[l].board + 1; i <= legs[l].alight; i++)
+            addRouteStep(ctx, stops[i - 1], stops[i], km[i] - km[i - 1]);
+    }
+}
+
+// 열차 한 번 탄 구간의 출발/도착 시각
+int legTime(const RaptorLeg* leg, int stop) {
+    const TimetableRoute* route = &timetable.routes[leg->route];
+    return timetable.stopTimes[route->firstTrip + leg->trip * route->stopCount + stop];
+}
+
+// 출발 시간대 [from, to] 안의 모든 출발 시각에 대해 더 늦게 떠나거나 더 일찍 도착하는 경로만 모은다 (rRAPTOR).
+// 출발역에서 열차가 떠나는 시각만 보면 되므로 그 시각들을 늦은 것부터 차례로 돌고, 라벨은 지우지 않고 이어서 쓴다.
+// 늦게 떠나서 닿은 시각은 일찍 떠나도 닿을 수 있으므로 앞 결과가 그대로 가지치기가 된다
+typedef struct ProfileEntry {
+    int departure;  // 출발역에서 첫 열차가 떠나는 시각
+    int arrival;
+    int legCount;
+    RaptorLeg legs[RAPTOR_MAX_ROUNDS];
+} ProfileEntry;
+
+// 결과는 출발 시각 순서로 entries에 담고 개수를 돌려준다 (entries는 호출한 쪽이 free). runs에는 돈 출발 시각 수
+int profileSearch(int start, int end, int from, int to, ProfileEntry** entries, int* runs) {
+    ensureTimetable();
+    const Timetable* tt = &timetable;
+
+    // 출발역의 노선들이 시간대 안에 떠나는 시각 (정렬, 중복 제거). 시간대 끝에 나서서 다음 열차를 기다리는 경우도 넣는다
+    int count = 0, capacity = 64;
+    int* departures = (int*)malloc(sizeof(int) * capacity);
+    departures[count++] = to;
+    for (int n = routeGraph.stationFirst[start]; n < routeGraph.stationFirst[start + 1]; n++)
+        for (int j = tt->stopRouteOffsets[n]; j < tt->stopRouteOffsets[n + 1]; j++) {
+            const TimetableRoute* route = &tt->routes[tt->stopRoutes[j]];
+            int i = tt->stopRouteIndex[j];
+            if (i == route->stopCount - 1) continue;  // 종착역에서는 떠나지 않음
+            for (int trip = earliestTrip(route, i, from, route->tripCount); trip != -1 && trip < route->tripCount; trip++) {
+                int time = tt->stopTimes[route->firstTrip + trip * route->stopCount + i];
+                if (time > to) break;
+                if (count == capacity) {
+                    capacity *= 2;
+                    departures = (int*)realloc(departures, sizeof(int) * capacity);
+                }
+                departures[count++] = time;
+            }
+        }
+    qsort(departures, count, sizeof(int), compareInt);
+
+    RaptorState* rs = &raptorState;
+    resetRaptorState(rs);
+    int found = 0, foundCapacity = 0, lastArrival = NO_TIME;
+    *entries = NULL;
+    *runs = 0;
+    for (int d = count - 1; d >= 0; d--) {
+        if (d + 1 < count && departures[d] == departures[d + 1]) continue;
+        (*runs)++;
+        int arrival = raptorSearch(rs, start, end, departures[d]);
+        if (arrival >= lastArrival) continue;  // 더 늦게 떠나도 같은 시각에 닿음
+        lastArrival = arrival;
+
+        if (found == foundCapacity) {
+            foundCapacity = foundCapacity ? foundCapacity * 2 : 16;
+            *entries = (ProfileEntry*)realloc(*entries, sizeof(ProfileEntry) * foundCapacity);
+        }
+        ProfileEntry* entry = &(*entries)[found++];
+        entry->legCount = raptorJourney(rs, end, entry->legs, RAPTOR_MAX_ROUNDS);
+        entry->departure = entry->legCount > 0 ? legTime(&entry->legs[0], entry->legs[0].board) : departures[d];
+        entry->arrival = arrival;
+    }
+    free(departures);
+
+    // 늦은 출발부터 모았으므로 뒤집는다
+    for (int i = 0; i < found / 2; i++) {
+        ProfileEntry t = (*entries)[i];
+        (*entries)[i] = (*entries)[found - 1 - i];
+        (*entries)[found - 1 - i] = t;
+    }
+    return found;
+}
+
+// ---------------------- 다대다 행렬 ----------------------
+
+// 출발역 목록 x 도착역 목록의 최소 시간, 최단 거리, 최소 요금을 한 번에 채운다.
+// 시간은 CH 위의 버킷 방식: 도착역마다 거꾸로 올라가는 탐색 결과를 노드별 버킷에 적어 두고,
+// 출발역마다 올라가는 탐색 한 번으로 만나는 버킷을 훑어 한 행을 채운다.
+// 거리는 출발역마다 모드 2 비용(거리 + 환승 패널티) 트리 하나로 채워서 findPath/routeBatch의 최단 거리 경로와 같게 하고,
+// 요금은 미터 단위 최단 거리 트리(환승 무시, 요금은 이 거리로만 정해짐)로 채운다.
+// 출발역/도착역 단위로 작업 스레드에 나눠 준다
+#define MATRIX_UNREACHABLE -1.0f
+
+typedef struct TravelMatrix {
+    int sourceCount;
+    int targetCount;
+    float* time;      // [i * targetCount + j] 최소 시간 (분), 못 가면 MATRIX_UNREACHABLE
+    float* distance;  // 최단 거리 경로(모드 2)의 거리 (km), 못 가면 MATRIX_UNREACHABLE
+    int* fare;        // 최소 요금, 못 가면 -1
+} TravelMatrix;
+
+typedef struct MatrixBucket {
+    int target;   // 도착역 목록 안의 번호
+    float cost;   // 이 노드에서 도착역까지
+} MatrixBucket;
+
+typedef struct MatrixJobs {
+    const int* sources;
+    const int* targets;
+    int sourceCount;
+    int targetCount;
+    const ContractionHierarchy* ch;
+    const ChCost* costs;   // 시간 비용
+    int** reachNodes;      // 도착역별로 거꾸로 올라가며 확정한 노드와 비용 (1단계 결과)
+    float** reachCosts;
+    int* reachCounts;
+    int* bucketOffsets;    // CH 노드 -> 버킷 [bucketOffsets[v], bucketOffsets[v + 1])
+    MatrixBucket* buckets;
+    char* targetNode;      // 노선 그래프 노드가 어떤 도착역의 도착 노드이면 1
+    int targetNodeCount;   // 서로 다른 도착 노드 수 (거리 트리 조기 종료용)
+    SearchContext* contexts;
+    TravelMatrix* matrix;
+    volatile long next;
+    volatile long nextWorker;
+} MatrixJobs;
+
+// CH에서 node부터 순위가 올라가는 방향으로만 끝까지 탐색. 확정한 노드를 순서대로 ctx->path에 남기고 개수를 돌려준다
+int chUpwardSearch(const ContractionHierarchy* ch, const ChCost* costs, SearchContext* ctx, int node, int forward) {
+    reserveSearchContext(ctx, ch->nodeCount);
+    beginSearch(ctx);
+    heapClear(&ctx->heap, ctx->cost);
+    touchStation(ctx, node);
+    ctx->cost[node] = 0;
+    heapPush(&ctx->heap, node);
+
+    const int* offsets = forward ? ch->upOffsets : ch->downOffsets;
+    const int* edges = forward ? ch->upEdges : ch->downEdges;
+    int count = 0;
+    while (ctx->heap.size > 0) {
+        int u = heapPop(&ctx->heap);
+        ctx->settled[u] = ctx->generation;
+        ctx->path[count++] = u;
+        for (int i = offsets[u]; i < offsets[u + 1]; i++) {
+            const ChEdge* e = &ch->edges[edges[i]];
+            int v = forward ? e->to : e->from;
+            if (isSettled(ctx, v)) continue;
+            touchStation(ctx, v);
+            if (ctx->cost[u] + costs[edges[i]].weight < ctx->cost[v]) {
+                ctx->cost[v] = ctx->cost[u] + costs[edges[i]].weight;
+                heapPush(&ctx->heap, v);
+            }
+        }
+    }
+    return count;
+}
+
+SearchContext* matrixContext(MatrixJobs* jobs) {
+    return &jobs->contexts[atomicAdd(&jobs->nextWorker, 1)];
+}
+
+// 1단계: 도착역마다 거꾸로 올라가는 탐색
+void matrixTargetWorker(void* arg) {
+    MatrixJobs* jobs = (MatrixJobs*)arg;
+    SearchContext* ctx = matrixContext(jobs);
+    while (1) {
+        long j = atomicAdd(&jobs->next, 1);
+        if (j >= jobs->targetCount) break;
+        int count = chUpwardSearch(jobs->ch, jobs->costs, ctx, arriveNode(jobs->targets[j]), 0);
+        jobs->reachNodes[j] = (int*)malloc(sizeof(int) * count);
+        jobs->reachCosts[j] = (float*)malloc(sizeof(float) * count);
+        for (int i = 0; i < count; i++) {
+            jobs->reachNodes[j][i] = ctx->path[i];
+            jobs->reachCosts[j][i] = ctx->cost[ctx->path[i]];
+        }
+        jobs->reachCounts[j] = count;
+    }
+}
+
+// 노선 그래프에서 source부터 최단 경로 트리. meters가 1이면 미터 단위 거리, 0이면 모드 2 비용으로 고르고
+// ctx->dist에 그 경로의 km를 남긴다. 도착 노드를 모두 확정하면 멈춘다
+void matrixTree(MatrixJobs* jobs, SearchContext* ctx, int source, int meters) {
+    reserveSearchContext(ctx, routeGraph.nodeCount);
+    beginSearch(ctx);
+    heapClear(&ctx->heap, ctx->cost);
+    touchStation(ctx, source);
+    ctx->cost[source] = 0;
+    heapPush(&ctx->heap, source);
+    int remaining = jobs->targetNodeCount;
+    while (ctx->heap.size > 0 && remaining > 0) {
+        int u = heapPop(&ctx->heap);
+        ctx->settled[u] = ctx->generation;
+        if (jobs->targetNode[u]) remaining--;
+        for (int k = routeGraph.offsets[u]; k < routeGraph.offsets[u + 1]; k++) {
+            int v = routeGraph.target[k];
+            if (isSettled(ctx, v) || routeEdgeClosed(&routeGraph, k)) continue;
+            touchStation(ctx, v);
+            float cost = ctx->cost[u] + (meters ? (float)routeGraph.meters[k] : routeGraph.weightDist[k]);
+            if (cost < ctx->cost[v]) {
+                ctx->cost[v] = cost;
+                ctx->dist[v] = ctx->dist[u] + routeGraph.km[k];
+                heapPush(&ctx->heap, v);
+            }
+        }
+    }
+}
+
+// 2단계: 출발역마다 올라가는 탐색으로 시간 행을, 거리 트리로 거리/요금 행을 채운다 (행은 스레드마다 따로)
+void matrixSourceWorker(void* arg) {
+    MatrixJobs* jobs = (MatrixJobs*)arg;
+    SearchContext* ctx = matrixContext(jobs);
+    TravelMatrix* matrix = jobs->matrix;
+    int M = jobs->targetCount;
+    while (1) {
+        long i = atomicAdd(&jobs->next, 1);
+        if (i >= jobs->sourceCount) break;
+        float* time = &matrix->time[i * M];
+        float* distance = &matrix->distance[i * M];
+        int* fare = &matrix->fare[i * M];
+        for (int j = 0; j < M; j++) time[j] = INT_MAX;
+
+        int count = chUpwardSearch(jobs->ch, jobs->costs, ctx, departNode(jobs->sources[i]), 1);
+        for (int n = 0; n < count; n++) {
+            int v = ctx->path[n];
+            for (int b = jobs->bucketOffsets[v]; b < jobs->bucketOffsets[v + 1]; b++) {
+                float cost = ctx->cost[v] + jobs->buckets[b].cost;
+                if (cost < time[jobs->buckets[b].target]) time[jobs->buckets[b].target] = cost;
+            }
+        }
+        for (int j = 0; j < M; j++)
+            if (time[j] == INT_MAX) time[j] = MATRIX_UNREACHABLE;
+
+        matrixTree(jobs, ctx, departNode(jobs->sources[i]), 0);
+        for (int j = 0; j < M; j++) {
+            int sink = arriveNode(jobs->targets[j]);
+            distance[j] = isSettled(ctx, sink) ? ctx->dist[sink] : MATRIX_UNREACHABLE;
+        }
+        matrixTree(jobs, ctx, departNode(jobs->sources[i]), 1);
+        for (int j = 0; j < M; j++) {
+            int sink = arriveNode(jobs->targets[j]);
+            fare[j] = isSettled(ctx, sink) ? fareForMeters((int)ctx->cost[sink]) : -1;
+        }
+    }
+}
+
+// 역 이름 목록으로 행렬을 채운다. 없는 역 이름이 있으면 0
+int buildTravelMatrix(const char** sourceNames, int sourceCount, const char** targetNames, int targetCount, TravelMatrix* matrix) {
+    int* sources = (int*)malloc(sizeof(int) * (sourceCount ? sourceCount : 1));
+    int* targets = (int*)malloc(sizeof(int) * (targetCount ? targetCount : 1));
+    int ok = 1;
+    for (int i = 0; i < sourceCount + targetCount; i++) {
+        const char* name = i < sourceCount ? sourceNames[i] : targetNames[i - sourceCount];
+        int station = getStationIndexByName(name);
+        if (station == -1) {
+            printf("입력한 역이 존재하지 않습니다: %s\n", name);
+            ok = 0;
+        }
+        if (i < sourceCount) sources[i] = station;
+        else targets[i - sourceCount] = station;
+    }
+    if (!ok) {
+        free(sources);
+        free(targets);
+        return 0;
+    }
+
+    // 공유하는 색인은 작업 스레드를 띄우기 전에 모두 만들어 둔다
+    ensureRouteGraph();
+    MatrixJobs jobs;
+    memset(&jobs, 0, sizeof(MatrixJobs));
+    jobs.sources = sources;
+    jobs.targets = targets;
+    jobs.sourceCount = sourceCount;
+    jobs.targetCount = targetCount;
+    jobs.ch = ensureHierarchy(1);
+    jobs.costs = jobs.ch->costs[0];
+    jobs.matrix = matrix;
+    matrix->sourceCount = sourceCount;
+    matrix->targetCount = targetCount;
+    long long cells = (long long)sourceCount * targetCount;
+    matrix->time = (float*)malloc(sizeof(float) * (cells ? cells : 1));
+    matrix->distance = (float*)malloc(sizeof(float) * (cells ? cells : 1));
+    matrix->fare = (int*)malloc(sizeof(int) * (cells ? cells : 1));
+
+    int N = jobs.ch->nodeCount;
+    jobs.targetNode = (char*)calloc(routeGraph.nodeCount, 1);
+    for (int j = 0; j < targetCount; j++) {
+        if (!jobs.targetNode[arriveNode(targets[j])]) jobs.targetNodeCount++;
+        jobs.targetNode[arriveNode(targets[j])] = 1;
+    }
+
+    int workers = processorCount();
+    int most = sourceCount > targetCount ? sourceCount : targetCount;
+    if (workers > most) workers = most > 0 ? most : 1;
+    jobs.contexts = (SearchContext*)calloc(workers, sizeof(SearchContext));
+
+    // 1단계 결과를 노드별 버킷으로 모은다
+    jobs.reachNodes = (int**)calloc(targetCount ? targetCount : 1, sizeof(int*));
+    jobs.reachCosts = (float**)calloc(targetCount ? targetCount : 1, sizeof(float*));
+    jobs.reachCounts = (int*)calloc(targetCount ? targetCount : 1, sizeof(int));
+    runWorkers(targetCount < workers ? targetCount : workers, matrixTargetWorker, &jobs);
+    jobs.bucketOffsets = (int*)calloc(N + 1, sizeof(int));
+    for (int j = 0; j < targetCount; j++)
+        for (int i = 0; i < jobs.reachCounts[j]; i++) jobs.bucketOffsets[jobs.reachNodes[j][i] + 1]++;
+    for (int v = 0; v < N; v++) jobs.bucketOffsets[v + 1] += jobs.bucketOffsets[v];
+    jobs.buckets = (MatrixBucket*)malloc(sizeof(MatrixBucket) * (jobs.bucketOffsets[N] ? jobs.bucketOffsets[N] : 1));
+    int* fill = (int*)malloc(sizeof(int) * (N ? N : 1));
+    memcpy(fill, jobs.bucketOffsets, sizeof(int) * N);
+    for (int j = 0; j < targetCount; j++) {
+        for (int i = 0; i < jobs.reachCounts[j]; i++) {
+            MatrixBucket* bucket = &jobs.buckets[fill[jobs.reachNodes[j][i]]++];
+            bucket->target = j;
+            bucket->cost = jobs.reachCosts[j][i];
+        }
+        free(jobs.reachNodes[j]);
+        free(jobs.reachCosts[j]);
+    }
+    free(fill);
+
+    jobs.next = 0;
+    jobs.nextWorker = 0;
+    runWorkers(sourceCount < workers ? sourceCount : workers, matrixSourceWorker, &jobs);
+
+    for (int w = 0; w < workers; w++) freeSearchContext(&jobs.contexts[w]);
+    free(jobs.contexts);
+    free(jobs.reachNodes);
+    free(jobs.reachCosts);
+    free(jobs.reachCounts);
+    free(jobs.bucketOffsets);
+    free(jobs.buckets);
+    free(jobs.targetNode);
+    free(sources);
+    free(targets);
+    return 1;
+}
+
+void freeTravelMatrix(TravelMatrix* matrix) {
+    free(matrix->time);
+    free(matrix->distance);
+    free(matrix->fare);
+    memset(matrix, 0, sizeof(TravelMatrix));
+}
+
+// ---------------------- 허브 최단 경로 트리 ----------------------
+
+// 질의는 큰 환승역 몇 곳에서 출발하는 경우가 많다. 그런 역(허브)마다 모든 노드까지의 최단 경로 트리를
+// 모드(시간/거리)별로 만들어 두고, 허브에서 출발하는 질의는 탐색 없이 트리의 prev만 따라가서 경로를 되짚는다.
+// 허브는 메뉴에서 역 이름으로 정하고, 정하지 않았으면 호선이 가장 많이 만나는 역부터 HUB_AUTO_COUNT개를 쓴다.
+// 트리는 노선도를 불러올 때 모든 코어로 나눠 만들고, 편집이나 구간 통제 뒤에는 다음에 필요할 때 다시 만든다.
+// 만든 트리 묶음은 고치지 않고 통째로 갈아 끼우며, 라우팅 스냅샷도 참조를 쥐고 같이 쓴다 (참조 수)
+#define HUB_MAX 32
+#define HUB_AUTO_COUNT 8
+
+typedef struct HubTrees {
+    volatile long refs;
+    int version;            // 만들 때의 노선 그래프 version / metric
+    int metric;
+    int stationCount;
+    int nodeCount;
+    int hubCount;
+    int hubs[HUB_MAX];      // 역 번호
+    int* hubOf;             // 역 -> 허브 순번 (허브가 아니면 -1)
+    float* cost;            // 트리 t(= 허브 순번 * 2 + 모드 - 1)의 노드 v는 [t * nodeCount + v]. 못 가면 INT_MAX
+    float* dist;            // 출발역부터 km
+    int* prev;              // 앞 노드 (출발 노드와 못 가는 노드는 -1). 호선은 노드의 nodeLine
+    int* prevEdge;          // 앞 노드에서 들어온 간선
+    double buildMs;
+} HubTrees;
+
+typedef struct HubJobs {
+    HubTrees* trees;
+    SearchContext* contexts;
+    volatile long next;
+    volatile long nextWorker;
+} HubJobs;
+
+HubTrees* hubTrees = NULL;                 // 마지막으로 만든 트리 묶음 (노선 그래프가 바뀌었으면 옛 것)
+char hubNames[HUB_MAX][MAX_STATION_NAME];  // 메뉴에서 정한 허브 (없으면 자동으로 고름)
+int hubNameCount = 0;
+int hubTreesEnabled = 1;
+
+void releaseHubTrees(HubTrees* trees) {
+    if (!trees || atomicAdd(&trees->refs, -1) != 1) return;
+    free(trees->hubOf);
+    free(trees->cost);
+    free(trees->dist);
+    free(trees->prev);
+    free(trees->prevEdge);
+    free(trees);
+}
+
+// 허브 설정이 바뀌었을 때 지금 트리 묶음을 버림 (스냅샷이 쥔 것은 그쪽이 놓을 때 해제)
+void dropHubTrees() {
+    releaseHubTrees(hubTrees);
+    hubTrees = NULL;
+}
+
+// 정한 이름이 있으면 그 역들, 없으면 호선 수(같으면 연결 수)가 가장 많은 역부터 고른다
+void chooseHubs(HubTrees* trees) {
+    trees->hubCount = 0;
+    if (hubNameCount > 0) {
+        for (int i = 0; i < hubNameCount; i++) {
+            int s = getStationIndexByName(hubNames[i]);
+            if (s != -1 && trees->hubOf[s] == -1) {
+                trees->hubOf[s] = trees->hubCount;
+                trees->hubs[trees->hubCount++] = s;
+            }
+        }
+        return;
+    }
+    while (trees->hubCount < HUB_AUTO_COUNT) {
+        int best = -1, bestLines = 0, bestDegree = 0;
+        for (int s = 0; s < trees->stationCount; s++) {
+            if (stations[s].deleted || trees->hubOf[s] != -1) continue;
+            int lines = routeGraph.stationFirst[s + 1] - routeGraph.stationFirst[s];
+            int degree = graph.offsets[s + 1] - graph.offsets[s];
+            if (lines > bestLines || (lines == bestLines && lines > 0 && degree > bestDegree)) {
+                best = s;
+                bestLines = lines;
+                bestDegree = degree;
+            }
+        }
+        if (best == -1) break;
+        trees->hubOf[best] = trees->hubCount;
+        trees->hubs[trees->hubCount++] = best;
+    }
+}
+
+// 노선 그래프에서 source부터 끝까지 Dijkstra (이진 힙). 막힌 간선은 비용이 INT_MAX라 저절로 건너뛴다
+void hubTreeSearch(SearchContext* ctx, int source, int mode) {
+    reserveSearchContext(ctx, routeGraph.nodeCount);
+    beginSearch(ctx);
+    heapClear(&ctx->heap, ctx->cost);
+    touchStation(ctx, source);
+    ctx->cost[source] = 0;
+    heapPush(&ctx->heap, source);
+    while (ctx->heap.size > 0) {
+        int u = heapPop(&ctx->heap);
+        ctx->settled[u] = ctx->generation;
+        for (int k = routeGraph.offsets[u]; k < routeGraph.offsets[u + 1]; k++) {
+            int v = routeGraph.target[k];
+            if (isSettled(ctx, v)) continue;
+            touchStation(ctx, v);
+            float cost = ctx->cost[u] + routeWeight(k, mode);
+            if (cost < ctx->cost[v]) {
+                ctx->cost[v] = cost;
+                ctx->prev[v] = u;
+                ctx->prevLine[v] = k;  // 트리에서는 들어온 간선 번호를 둔다
+                ctx->dist[v] = ctx->dist[u] + routeGraph.km[k];
+                heapPush(&ctx->heap, v);
+            }
+        }
+    }
+}
+
+// 트리 하나씩 가져가서 만든다 (트리마다 쓰는 칸이 달라서 잠글 필요 없음)
+void hubTreeWorker(void* arg) {
+    HubJobs* jobs = (HubJobs*)arg;
+    HubTrees* trees = jobs->trees;
+    SearchContext* ctx = &jobs->contexts[atomicAdd(&jobs->nextWorker, 1)];
+    int N = trees->nodeCount;
+    while (1) {
+        long t = atomicAdd(&jobs->next, 1);
+        if (t >= trees->hubCount * 2) break;
+        hubTreeSearch(ctx, departNode(trees->hubs[t / 2]), (int)(t % 2) + 1);
+        float* cost = &trees->cost[t * N];
+        float* dist = &trees->dist[t * N];
+        int* prev = &trees->prev[t * N];
+        int* prevEdge = &trees->prevEdge[t * N];
+        for (int v = 0; v < N; v++) {
+            if (ctx->seen[v] == ctx->generation) {
+                cost[v] = ctx->cost[v];
+                dist[v] = ctx->dist[v];
+                prev[v] = ctx->prev[v];
+                prevEdge[v] = ctx->prevLine[v];
+            }
+            else {
+                cost[v] = INT_MAX;
+                dist[v] = 0.0f;
+                prev[v] = -1;
+                prevEdge[v] = -1;
+            }
+        }
+    }
+}
+
+HubTrees* buildHubTrees() {
+    clock_t begin = clock();
+    HubTrees* trees = (HubTrees*)calloc(1, sizeof(HubTrees));
+    trees->refs = 1;
+    trees->version = routeGraph.version;
+    trees->metric = routeGraph.metric;
+    trees->stationCount = routeGraph.stationCount;
+    trees->nodeCount = routeGraph.nodeCount;
+    trees->hubOf = (int*)malloc(sizeof(int) * (trees->stationCount ? trees->stationCount : 1));
+    for (int s = 0; s < trees->stationCount; s++) trees->hubOf[s] = -1;
+    chooseHubs(trees);
+
+    long cells = (long)trees->hubCount * 2 * trees->nodeCount;
+    trees->cost = (float*)malloc(sizeof(float) * (cells ? cells : 1));
+    trees->dist = (float*)malloc(sizeof(float) * (cells ? cells : 1));
+    trees->prev = (int*)malloc(sizeof(int) * (cells ? cells : 1));
+    trees->prevEdge = (int*)malloc(sizeof(int) * (cells ? cells : 1));
+
+    HubJobs jobs;
+    memset(&jobs, 0, sizeof(HubJobs));
+    jobs.trees = trees;
+    int workers = processorCount();
+    if (workers > trees->hubCount * 2) workers = trees->hubCount * 2;
+    if (workers > 0) {
+        jobs.contexts = (SearchContext*)calloc(workers, sizeof(SearchContext));
+        runWorkers(workers, hubTreeWorker, &jobs);
+        for (int w = 0; w < workers; w++) freeSearchContext(&jobs.contexts[w]);
+        free(jobs.contexts);
+    }
+    trees->buildMs = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+    return trees;
+}
+
+// 지금 노선 그래프용 트리 묶음 (꺼져 있으면 NULL). 편집이나 구간 통제 뒤 처음 부를 때 다시 만든다
+HubTrees* ensureHubTrees() {
+    if (!hubTreesEnabled) return NULL;
+    ensureRouteGraph();
+    if (hubTrees && hubTrees->version == routeGraph.version && hubTrees->metric == routeGraph.metric) return hubTrees;
+    dropHubTrees();
+    hubTrees = buildHubTrees();
+    return hubTrees;
+}
+
+// station에서 출발하는 mode 트리 번호 (허브가 아니면 -1)
+int hubTreeOf(const HubTrees* trees, int station, int mode) {
+    if (!trees || mode < 1 || mode > 2 || station < 0 || station >= trees->stationCount) return -1;
+    int h = trees->hubOf[station];
+    return h == -1 ? -1 : h * 2 + mode - 1;
+}
+
+// 트리에서 end까지의 경로를 역 단위로 ctx에 옮김 (findPath 출력용). 트리의 km는 누적이라 순서와 상관없이 채운다
+int copyHubPath(SearchContext* ctx, const HubTrees* trees, int tree, int start, int end) {
+    beginRouteResult(ctx, start, 0);
+    const float* cost = &trees->cost[(long)tree * trees->nodeCount];
+    const float* dist = &trees->dist[(long)tree * trees->nodeCount];
+    const int* prev = &trees->prev[(long)tree * trees->nodeCount];
+    int sink = arriveNode(end);
+    if (cost[sink] == INT_MAX) return 0;
+    for (int b = sink; prev[b] != -1; b = prev[b]) {
+        int a = prev[b];
+        if (a >= routeGraph.routeNodeCount || b >= routeGraph.routeNodeCount) continue;
+        int s = routeGraph.nodeStation[a], t = routeGraph.nodeStation[b];
+        if (s == t) continue;
+        touchStation(ctx, t);
+        ctx->prev[t] = s;
+        ctx->prevLine[t] = routeGraph.nodeLine[b];
+        ctx->dist[t] = dist[b];
+    }
+    ctx->cost[end] = cost[sink];
+    ctx->dist[end] = dist[sink];
+    return 1;
+}
+
+// ---------------------- 라우팅 API (여러 스레드) ----------------------
+
+// 메뉴 없이 다른 코드가 여러 스레드에서 동시에 길찾기를 부를 수 있게 한 API.
+// 노선 그래프와 역 이름을 통째로 복사한 읽기 전용 스냅샷을 모든 스레드가 같이 쓰고, 탐색 작업 공간은 스레드마다 따로 둔다.
+// 편집하는 스레드(메뉴)가 publishRoutingSnapshot으로 새 스냅샷을 내놓으면 그 뒤 질의부터 새 것을 쓰고,
+// 예전 스냅샷은 그것을 쥐고 있던 마지막 질의가 놓을 때 해제된다 (참조 수)
+typedef struct RoutingSnapshot {
+    volatile long refs;
+    int version;             // 만들 때의 graphVersion
+    int stationCount;
+    char* names;             // 역 이름 (NUL로 끝나게 이어 붙임)
+    int* nameOffsets;
+    unsigned* nameHashes;
+    int* nameIndex;          // 역 이름 색인 (open addressing, 빈 칸은 -1)
+    int nameIndexCapacity;
+    RouteGraph graph;        // 노선 그래프 복사본 (환승 규칙 목록은 비어 있음)
+    HubTrees* hubs;          // 같은 노선 그래프로 만든 허브 트리 (참조 하나를 쥠, 꺼져 있으면 NULL)
+} RoutingSnapshot;
+
+// 경로의 역 하나 (출발역은 line 0, km 0)
+typedef struct RouteStep {
+    int station;
+    int line;                // 이 역으로 올 때 탄 호선
+    float km;                // 출발역부터 거리
+} RouteStep;
+
+// 탐색 작업 공간 (스레드마다 하나). 마지막 질의의 경로를 역 단위로 들고 있다
+typedef struct RoutingWorkspace {
+    SearchContext forward;
+    SearchContext backward;
+    FareLabels labels;
+    RouteStep* path;
+    int pathCount;
+    int pathCapacity;
+} RoutingWorkspace;
+
+typedef struct RouteRequest {
+    int start;               // 스냅샷의 역 번호 (routingStation으로 찾음)
+    int end;
+    int mode;                // 1: 최소 시간, 2: 최단 거리, 3: 최소 요금
+} RouteRequest;
+
+typedef struct RouteAnswer {
+    int found;               // 1: 경로 있음, 0: 없음, -1: 잘못된 요청
+    float time;              // 분 (환승 시간 포함)
+    float distance;          // km
+    int fare;
+    int transfers;
+    int settled;             // 확정한 노드 수 (캐시에서 찾았으면 0)
+    int cached;              // 1이면 경로 캐시에서 찾음
+} RouteAnswer;
+
+RoutingSnapshot* currentRouting = NULL;  // 지금 내놓은 스냅샷 (이 포인터도 참조 하나를 쥠)
+volatile long routingLock = 0;
+
+void* duplicateBlock(const void* data, size_t size) {
+    void* copy = malloc(size ? size : 1);
+    if (size) memcpy(copy, data, size);
+    return copy;
+}
+
+void freeRoutingSnapshot(RoutingSnapshot* snap) {
+    RouteGraph* g = &snap->graph;
+    free(snap->names);
+    free(snap->nameOffsets);
+    free(snap->nameHashes);
+    free(snap->nameIndex);
+    free(g->stationFirst);
+    free(g->nodeStation);
+    free(g->nodeLine);
+    free(g->offsets);
+    free(g->target);
+    free(g->weightTime);
+    free(g->weightDist);
+    free(g->km);
+    free(g->meters);
+    free(g->kind);
+    free(g->rOffsets);
+    free(g->rSource);
+    free(g->rEdge);
+    releaseHubTrees(snap->hubs);
+    free(snap);
+}
+
+// 참조를 놓음. 마지막 참조였으면 해제
+void releaseRoutingSnapshot(RoutingSnapshot* snap) {
+    if (atomicAdd(&snap->refs, -1) == 1) freeRoutingSnapshot(snap);
+}
+
+// 지금 노선도로 새 스냅샷을 만들어 내놓음. 편집하는 스레드에서만 부른다
+void publishRoutingSnapshot() {
+    ensureRouteGraph();
+    const RouteGraph* src = &routeGraph;
+    int V = src->stationCount, N = src->nodeCount, E = src->edgeCount;
+    RoutingSnapshot* snap = (RoutingSnapshot*)calloc(1, sizeof(RoutingSnapshot));
+    snap->refs = 1;
+    snap->version = src->version;
+    snap->stationCount = V;
+
+    size_t total = 0;
+    for (int i = 0; i < V; i++) total += strlen(stations[i].name) + 1;
+    snap->names = (char*)malloc(total ? total : 1);
+    snap->nameOffsets = (int*)malloc(sizeof(int) * (V > 0 ? V : 1));
+    snap->nameHashes = (unsigned*)malloc(sizeof(unsigned) * (V > 0 ? V : 1));
+    size_t used = 0;
+    for (int i = 0; i < V; i++) {
+        size_t length = strlen(stations[i].name) + 1;
+        memcpy(snap->names + used, stations[i].name, length);
+        snap->nameOffsets[i] = (int)used;
+        snap->nameHashes[i] = stations[i].hash;
+        used += length;
+    }
+    snap->nameIndexCapacity = 64;
+    while (snap->nameIndexCapacity < V * 2) snap->nameIndexCapacity *= 2;
+    snap->nameIndex = (int*)malloc(sizeof(int) * snap->nameIndexCapacity);
+    for (int i = 0; i < snap->nameIndexCapacity; i++) snap->nameIndex[i] = -1;
+    unsigned mask = snap->nameIndexCapacity - 1;
+    for (int i = 0; i < V; i++) {
+        if (stations[i].deleted) continue;
+        unsigned slot = snap->nameHashes[i] & mask;
+        while (snap->nameIndex[slot] != -1) slot = (slot + 1) & mask;
+        snap->nameIndex[slot] = i;
+    }
+
+    RouteGraph* g = &snap->graph;
+    *g = *src;
+    g->stationFirst = (int*)duplicateBlock(src->stationFirst, sizeof(int) * (V + 1));
+    g->nodeStation = (int*)duplicateBlock(src->nodeStation, sizeof(int) * N);
+    g->nodeLine = (int*)duplicateBlock(src->nodeLine, sizeof(int) * N);
+    g->offsets = (int*)duplicateBlock(src->offsets, sizeof(int) * (N + 1));
+    g->target = (int*)duplicateBlock(src->target, sizeof(int) * E);
+    g->weightTime = (float*)duplicateBlock(src->weightTime, sizeof(float) * E);
+    g->weightDist = (float*)duplicateBlock(src->weightDist, sizeof(float) * E);
+    g->km = (float*)duplicateBlock(src->km, sizeof(float) * E);
+    g->meters = (int*)duplicateBlock(src->meters, sizeof(int) * E);
+    g->kind = (char*)duplicateBlock(src->kind, sizeof(char) * E);
+    g->rOffsets = (int*)duplicateBlock(src->rOffsets, sizeof(int) * (N + 1));
+    g->rSource = (int*)duplicateBlock(src->rSource, sizeof(int) * E);
+    g->rEdge = (int*)duplicateBlock(src->rEdge, sizeof(int) * E);
+    g->baseTime = NULL;
+    g->baseDist = NULL;
+    g->transferHead = NULL;
+    g->transferNext = NULL;
+    snap->hubs = ensureHubTrees();
+    if (snap->hubs) atomicAdd(&snap->hubs->refs, 1);
+
+    lockSpin(&routingLock);
+    RoutingSnapshot* old = currentRouting;
+    currentRouting = snap;
+    unlockSpin(&routingLock);
+    if (old) releaseRoutingSnapshot(old);
+}
+
+// 노선도나 구간 통제가 바뀌었을 때만 새로 내놓음
+void refreshRoutingSnapshot() {
+    ensureRouteGraph();
+    if (!currentRouting || currentRouting->version != routeGraph.version || currentRouting->graph.metric != routeGraph.metric)
+        publishRoutingSnapshot();
+}
+
+// 지금 스냅샷을 쥠 (없으면 NULL). 다 쓰면 releaseRoutingSnapshot
+RoutingSnapshot* acquireRoutingSnapshot() {
+    lockSpin(&routingLock);
+    RoutingSnapshot* snap = currentRouting;
+    if (snap) atomicAdd(&snap->refs, 1);
+    unlockSpin(&routingLock);
+    return snap;
+}
+
+// 스냅샷에서 역 이름으로 역 번호 찾기 (없으면 -1)
+int routingStation(const RoutingSnapshot* snap, const char* name) {
+    size_t length = strlen(name);
+    unsigned h = hashNameLength(name, length);
+    unsigned mask = snap->nameIndexCapacity - 1;
+    for (unsigned slot = h & mask; snap->nameIndex[slot] != -1; slot = (slot + 1) & mask) {
+        int i = snap->nameIndex[slot];
+        if (snap->nameHashes[i] == h && strcmp(snap->names + snap->nameOffsets[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+const char* routingStationName(const RoutingSnapshot* snap, int station) {
+    return snap->names + snap->nameOffsets[station];
+}
+
+void freeRoutingWorkspace(RoutingWorkspace* ws) {
+    FareLabels* fl = &ws->labels;
+    freeSearchContext(&ws->forward);
+    freeSearchContext(&ws->backward);
+    free(fl->node);
+    free(fl->meters);
+    free(fl->prev);
+    free(fl->edge);
+    free(fl->time);
+    free(fl->bestMeters);
+    free(fl->remaining);
+    free(fl->heap.heap);
+    free(fl->heap.pos);
+    free(ws->path);
+    memset(ws, 0, sizeof(RoutingWorkspace));
+}
+
+// 경로 캐시: (출발역, 도착역, 모드, 탐색 방식)별 마지막 답과 경로. 질의가 몇 백 개 역 쌍에 몰리므로 같은 쌍을 다시 풀지 않는다.
+// 탐색 방식(solver)도 키에 넣어서 길찾기에서 엔진/방식을 바꿔 비교할 때 다른 방식이 남긴 답을 꺼내지 않게 한다.
+// 항목마다 만들 때의 노선 그래프 버전(graphVersion, 구간 통제 metric)을 적어 두고 버전이 다르면 없는 것으로 본다.
+// 편집(호선/역 추가·삭제, CSV 다시 불러오기)은 다음 질의 전에 graphVersion을 올리므로 따로 비울 필요가 없다.
+// 집합 연관(set-associative) 구조: 키 해시로 집합 하나를 고르고 집합 안에서 CLOCK으로 교체한다.
+// 집합마다 잠금이 따로 있어서 여러 스레드가 동시에 찾아도 같은 집합이 아니면 서로 기다리지 않는다
+#define ROUTE_CACHE_SETS 64
+#define ROUTE_CACHE_WAYS 16
+#define ROUTE_SOLVER_API -1      // 라우팅 API (routeQuery)가 푼 답. 길찾기 메뉴는 routeSolver(방식, 엔진)
+
+typedef struct RouteCacheEntry {
+    int mode;                // 0이면 빈 칸
+    int start;
+    int end;
+    int solver;
+    int version;
+    int metric;
+    int referenced;          // CLOCK 참조 비트
+    RouteAnswer answer;
+    int stepCount;
+    int stepCapacity;
+    RouteStep* steps;
+} RouteCacheEntry;
+
+typedef struct RouteCacheSet {
+    volatile long lock;
+    int hand;                // CLOCK 바늘
+    long lookups;
+    long hits;
+    long evictions;
+    RouteCacheEntry entries[ROUTE_CACHE_WAYS];
+} RouteCacheSet;
+
+RouteCacheSet routeCache[ROUTE_CACHE_SETS];
+int routeCacheEnabled = 1;
+
+int routeSolver(int strategy, int engine) {
+    return strategy * 16 + engine;
+}
+
+RouteCacheSet* routeCacheSet(int start, int end, int mode, int solver) {
+    unsigned h = 2166136261u;
+    h = hashBytes(h, &start, sizeof(start));
+    h = hashBytes(h, &end, sizeof(end));
+    h = hashBytes(h, &mode, sizeof(mode));
+    h = hashBytes(h, &solver, sizeof(solver));
+    return &routeCache[h & (ROUTE_CACHE_SETS - 1)];
+}
+
+void reserveRouteSteps(RouteStep** steps, int* capacity, int count) {
+    if (count <= *capacity) return;
+    *capacity = count > 16 ? count : 16;
+    *steps = (RouteStep*)realloc(*steps, sizeof(RouteStep) * *capacity);
+}
+
+// 캐시에서 찾으면 answer와 경로(steps, 필요하면 늘림)를 채우고 1
+int routeCacheLookup(int start, int end, int mode, int solver, int version, int metric,
+    RouteAnswer* answer, RouteStep** steps, int* stepCount, int* stepCapacity) {
+    if (!routeCacheEnabled) return 0;
+    RouteCacheSet* set = routeCacheSet(start, end, mode, solver);
+    int hit = 0;
+    lockSpin(&set->lock);
+    set->lookups++;
+    for (int w = 0; w < ROUTE_CACHE_WAYS; w++) {
+        RouteCacheEntry* e = &set->entries[w];
+        if (e->mode != mode || e->start != start || e->end != end || e->solver != solver
+            || e->version != version || e->metric != metric) continue;
+        e->referenced = 1;
+        *answer = e->answer;
+        answer->settled = 0;
+        answer->cached = 1;
+        reserveRouteSteps(steps, stepCapacity, e->stepCount);
+        if (e->stepCount) memcpy(*steps, e->steps, sizeof(RouteStep) * e->stepCount);
+        *stepCount = e->stepCount;
+        set->hits++;
+        hit = 1;
+        break;
+    }
+    unlockSpin(&set->lock);
+    return hit;
+}
+
+// 새 답을 넣음. 같은 키가 있으면 덮어쓰고, 없으면 빈 칸이나 옛 버전 칸, 그것도 없으면 CLOCK으로 고른 칸에 넣는다
+void routeCacheStore(int start, int end, int mode, int solver, int version, int metric,
+    const RouteAnswer* answer, const RouteStep* steps, int stepCount) {
+    if (!routeCacheEnabled) return;
+    RouteCacheSet* set = routeCacheSet(start, end, mode, solver);
+    lockSpin(&set->lock);
+    RouteCacheEntry* slot = NULL;
+    for (int w = 0; w < ROUTE_CACHE_WAYS && !slot; w++) {
+        RouteCacheEntry* e = &set->entries[w];
+        if (e->mode == mode && e->start == start && e->end == end && e->solver == solver) slot = e;
+    }
+    for (int w = 0; w < ROUTE_CACHE_WAYS && !slot; w++) {
+        RouteCacheEntry* e = &set->entries[w];
+        if (e->mode == 0 || e->version != version || e->metric != metric) slot = e;
+    }
+    while (!slot) {
+        RouteCacheEntry* e = &set->entries[set->hand];
+        set->hand = (set->hand + 1) % ROUTE_CACHE_WAYS;
+        if (e->referenced) e->referenced = 0;
+        else {
+            slot = e;
+            set->evictions++;
+        }
+    }
+    slot->mode = mode;
+    slot->start = start;
+    slot->end = end;
+    slot->solver = solver;
+    slot->version = version;
+    slot->metric = metric;
+    slot->referenced = 1;
+    slot->answer = *answer;
+    slot->answer.cached = 0;
+    reserveRouteSteps(&slot->steps, &slot->stepCapacity, stepCount);
+    if (stepCount) memcpy(slot->steps, steps, sizeof(RouteStep) * stepCount);
+    slot->stepCount = stepCount;
+    unlockSpin(&set->lock);
+}
+
+// 캐시 크기와 적중률. current에는 지금 노선 그래프 버전인 항목 수
+void routeCacheStats(int version, int metric, int* current, long* lookups, long* hits, long* evictions) {
+    *current = 0;
+    *lookups = *hits = *evictions = 0;
+    for (int i = 0; i < ROUTE_CACHE_SETS; i++) {
+        RouteCacheSet* set = &routeCache[i];
+        lockSpin(&set->lock);
+        for (int w = 0; w < ROUTE_CACHE_WAYS; w++)
+            if (set->entries[w].mode != 0 && set->entries[w].version == version && set->entries[w].metric == metric) (*current)++;
+        *lookups += set->lookups;
+        *hits += set->hits;
+        *evictions += set->evictions;
+        unlockSpin(&set->lock);
+    }
+}
+
+void clearRouteCache() {
+    for (int i = 0; i < ROUTE_CACHE_SETS; i++) {
+        RouteCacheSet* set = &routeCache[i];
+        lockSpin(&set->lock);
+        for (int w = 0; w < ROUTE_CACHE_WAYS; w++) {
+            free(set->entries[w].steps);
+            memset(&set->entries[w], 0, sizeof(RouteCacheEntry));
+        }
+        set->hand = 0;
+        set->lookups = set->hits = set->evictions = 0;
+        unlockSpin(&set->lock);
+    }
+}
+
+// 스냅샷 그래프에서 source -> sink Dijkstra (도착 노드가 확정되면 종료, 이진 힙).
+// prev에는 들어온 간선 번호, prevLine에는 앞 노드를 적는다
+int routingDijkstra(const RouteGraph* g, SearchContext* ctx, int source, int sink, int mode) {
+    const float* weight = (mode == 1) ? g->weightTime : g->weightDist;
+    reserveSearchContext(ctx, g->nodeCount);
+    beginSearch(ctx);
+    heapClear(&ctx->heap, ctx->cost);
+    touchStation(ctx, source);
+    ctx->cost[source] = 0;
+    heapPush(&ctx->heap, source);
+
+    while (ctx->heap.size > 0) {
+        int u = heapPop(&ctx->heap);
+        ctx->settled[u] = ctx->generation;
+        ctx->settledCount++;
+        if (u == sink) return 1;
+        for (int k = g->offsets[u]; k < g->offsets[u + 1]; k++) {
+            int v = g->target[k];
+            if (isSettled(ctx, v)) continue;
+            touchStation(ctx, v);
+            float cost = ctx->cost[u] + weight[k];
+            if (cost < ctx->cost[v]) {
+                ctx->cost[v] = cost;
+                ctx->prev[v] = k;
+                ctx->prevLine[v] = u;
+                heapPush(&ctx->heap, v);
+            }
+        }
+    }
+    return 0;
+}
+
+// 경로의 간선 하나를 (도착 쪽부터 거꾸로) 답에 더함. 운행 간선이면 도착한 역을 경로에 넣는다 (km는 구간 거리)
+void routingAddEdge(const RouteGraph* g, RoutingWorkspace* ws, RouteAnswer* answer, int k, int* meters) {
+    answer->time += g->weightTime[k];
+    answer->distance += g->km[k];
+    *meters += g->meters[k];
+    if (g->kind[k] == ROUTE_TRANSFER) answer->transfers++;
+    if (g->kind[k] != ROUTE_RIDE) return;
+    if (ws->pathCount + 1 >= ws->pathCapacity) {
+        ws->pathCapacity = ws->pathCapacity ? ws->pathCapacity * 2 : 64;
+        ws->path = (RouteStep*)realloc(ws->path, sizeof(RouteStep) * ws->pathCapacity);
+    }
+    RouteStep step = { g->nodeStation[g->target[k]], g->nodeLine[g->target[k]], g->km[k] };
+    ws->path[ws->pathCount++] = step;
+}
+
+// 질의 하나. 스냅샷은 읽기만 하므로 작업 공간만 스레드마다 다르면 동시에 불러도 된다.
+// 경로는 다음 질의 전까지 ws->path[0 .. pathCount)에 남는다 (출발역부터). 같은 질의는 경로 캐시에서 꺼낸다
+int routeQuery(const RoutingSnapshot* snap, RoutingWorkspace* ws, const RouteRequest* request, RouteAnswer* answer) {
+    const RouteGraph* g = &snap->graph;
+    memset(answer, 0, sizeof(RouteAnswer));
+    ws->pathCount = 0;
+    int V = snap->stationCount;
+    if (request->start < 0 || request->start >= V || request->end < 0 || request->end >= V
+        || request->mode < 1 || request->mode > 3) {
+        answer->found = -1;
+        return -1;
+    }
+    if (routeCacheLookup(request->start, request->end, request->mode, ROUTE_SOLVER_API, snap->version, g->metric,
+        answer, &ws->path, &ws->pathCount, &ws->pathCapacity))
+        return answer->found;
+
+    int source = g->routeNodeCount + request->start;
+    int sink = g->routeNodeCount + V + request->end;
+    int meters = 0;
+    int tree = hubTreeOf(snap->hubs, request->start, request->mode);
+    if (tree != -1) {
+        // 허브에서 출발하면 트리를 거꾸로 따라가기만 한다
+        const HubTrees* hubs = snap->hubs;
+        const int* prev = &hubs->prev[(long)tree * hubs->nodeCount];
+        const int* prevEdge = &hubs->prevEdge[(long)tree * hubs->nodeCount];
+        if (hubs->cost[(long)tree * hubs->nodeCount + sink] == INT_MAX) {
+            routeCacheStore(request->start, request->end, request->mode, ROUTE_SOLVER_API, snap->version, g->metric, answer, NULL, 0);
+            return 0;
+        }
+        for (int v = sink; v != source; v = prev[v])
+            routingAddEdge(g, ws, answer, prevEdge[v], &meters);
+    }
+    else if (request->mode == 3) {
+        FareLabels* fl = &ws->labels;
+        int found = fareLabelSearch(g, fl, &ws->forward, &ws->backward, source, sink, &answer->settled);
+        if (found == -1) {
+            routeCacheStore(request->start, request->end, request->mode, ROUTE_SOLVER_API, snap->version, g->metric, answer, NULL, 0);
+            return 0;
+        }
+        for (int label = found; fl->prev[label] != -1; label = fl->prev[label])
+            routingAddEdge(g, ws, answer, fl->edge[label], &meters);
+    }
+    else {
+        SearchContext* ctx = &ws->forward;
+        int found = routingDijkstra(g, ctx, source, sink, request->mode);
+        answer->settled = ctx->settledCount;
+        if (!found) {
+            routeCacheStore(request->start, request->end, request->mode, ROUTE_SOLVER_API, snap->version, g->metric, answer, NULL, 0);
+            return 0;
+        }
+        for (int v = sink; v != source; v = ctx->prevLine[v])
+            routingAddEdge(g, ws, answer, ctx->prev[v], &meters);
+    }
+
+    // 도착 쪽부터 모았으므로 출발역을 붙이고 뒤집은 뒤 구간 거리를 누적 거리로 바꾼다
+    reserveRouteSteps(&ws->path, &ws->pathCapacity, ws->pathCount + 1);
+    RouteStep first = { request->start, 0, 0.0f };
+    ws->path[ws->pathCount++] = first;
+    for (int i = 0, j = ws->pathCount - 1; i < j; i++, j--) {
+        RouteStep t = ws->path[i];
+        ws->path[i] = ws->path[j];
+        ws->path[j] = t;
+    }
+    for (int i = 1; i < ws->pathCount; i++) ws->path[i].km += ws->path[i - 1].km;
+    answer->found = 1;
+    answer->fare = fareForMeters(meters);
+    routeCacheStore(request->start, request->end, request->mode, ROUTE_SOLVER_API, snap->version, g->metric, answer, ws->path, ws->pathCount);
+    return 1;
+}
+
+// 일괄 질의. 요청을 작업 스레드 수만큼 구간으로 나눠 주고, 자기 구간을 다 돈 스레드는
+// 다른 스레드 구간에서 하나씩 가져가서 돈다 (구간마다 다음 번호를 atomicAdd로 뽑음)
+typedef struct RouteBatchRange {
+    volatile long next;
+    long end;
+    char padding[64 - 2 * sizeof(long)];  // 구간끼리 같은 캐시 줄을 쓰지 않게
+} RouteBatchRange;
+
+typedef struct RouteBatch {
+    const RoutingSnapshot* snapshot;
+    const RouteRequest* requests;
+    RouteAnswer* answers;
+    RoutingWorkspace* workspaces;
+    RouteBatchRange ranges[MAX_WORKERS];
+    int workers;
+    volatile long nextWorker;
+} RouteBatch;
+
+void routeBatchWorker(void* arg) {
+    RouteBatch* batch = (RouteBatch*)arg;
+    int id = (int)atomicAdd(&batch->nextWorker, 1);
+    RoutingWorkspace* ws = &batch->workspaces[id];
+    for (int round = 0; round < batch->workers; round++) {
+        RouteBatchRange* range = &batch->ranges[(id + round) % batch->workers];
+        long i;
+        while ((i = atomicAdd(&range->next, 1)) < range->end)
+            routeQuery(batch->snapshot, ws, &batch->requests[i], &batch->answers[i]);
+    }
+}
+
+// count개의 요청을 workers개의 스레드로 풀어 answers에 채움 (workers가 0 이하면 코어 수)
+void routeBatch(const RoutingSnapshot* snap, const RouteRequest* requests, RouteAnswer* answers, int count, int workers) {
+    if (count <= 0) return;
+    if (workers <= 0) workers = processorCount();
+    if (workers > MAX_WORKERS) workers = MAX_WORKERS;
+    if (workers > count) workers = count;
+
+    RouteBatch batch;
+    memset(&batch, 0, sizeof(RouteBatch));
+    batch.snapshot = snap;
+    batch.requests = requests;
+    batch.answers = answers;
+    batch.workers = workers;
+    batch.workspaces = (RoutingWorkspace*)calloc(workers, sizeof(RoutingWorkspace));
+    for (int w = 0; w < workers; w++) {
+        batch.ranges[w].next = (long)count * w / workers;
+        batch.ranges[w].end = (long)count * (w + 1) / workers;
+    }
+    runWorkers(workers, routeBatchWorker, &batch);
+    for (int w = 0; w < workers; w++) freeRoutingWorkspace(&batch.workspaces[w]);
+    free(batch.workspaces);
+}
+
+// ---------------------- 편집 연산 ----------------------
+
+// 호선 하나의 간선을 모두 지움. 지운 간선 수 (양방향을 따로 셈).
+// 호선 색인에 있는 간선만 그 출발역 리스트에서 떼어 내므로 호선 크기에 비례한다
+int deleteLineEdges(int line) {
+    ensureEdgeLists();
+    LineEntry* entry = findLineEntry(line, 0);
+    if (!entry || entry->count == 0) return 0;
+    for (int i = 0; i < entry->count; i++) {
+        SubwayEdge** edgePtr = &stations[entry->edges[i].from].edge;
+        while (*edgePtr != entry->edges[i].edge) edgePtr = &(*edgePtr)->next;
+        *edgePtr = (*edgePtr)->next;
+        freeEdge(entry->edges[i].edge);
+    }
+    int deletedCount = entry->count;
+    entry->count = 0;
+    entry->sequenceValid = 0;
+    if (entry->suspended) {
+        entry->suspended = 0;
+        suspendedLineCount--;
+    }
+    dropDisruptions(-1, line);
+    graphDirty = 1;
+    return deletedCount;
+}
+
+// 호선 운행 중지/재개. 간선은 지우지 않고 표시만 바꾸므로 다시 열면 그대로 돌아온다.
+// 호선의 간선 수를 돌려줌 (0: 없는 호선)
+int setLineSuspended(int line, int suspended) {
+    ensureEdgeLists();
+    LineEntry* entry = findLineEntry(line, 0);
+    if (!entry || entry->count == 0) return 0;
+    if (entry->suspended != suspended) {
+        entry->suspended = suspended;
+        suspendedLineCount += suspended ? 1 : -1;
+        graphDirty = 1;
+    }
+    return entry->count;
+}
+
+int compareIntPairs(const void* a, const void* b) {
+    const int* x = (const int*)a;
+    const int* y = (const int*)b;
+    if (x[0] != y[0]) return x[0] < y[0] ? -1 : 1;
+    return (x[1] > y[1]) - (x[1] < y[1]);
+}
+
+// 호선의 역 순서를 호선 간선만으로 만듦. 종점(이웃 역이 하나인 역)에서 시작해 깊이 우선으로 따라가고,
+// 순환선처럼 종점이 없으면 번호가 가장 작은 역부터. 끊긴 구간이 있으면 구간마다 이어 붙이고,
+// 바로 앞 역과 이어지지 않는 역(끊긴 구간이나 갈래의 첫 역)은 segmentFrom에 표시한다
+void buildLineSequence(LineEntry* entry) {
+    int m = entry->count;
+    int* pairs = (int*)malloc(sizeof(int) * 2 * (m > 0 ? m : 1));
+    for (int i = 0; i < m; i++) {
+        pairs[2 * i] = entry->edges[i].from;
+        pairs[2 * i + 1] = entry->edges[i].edge->destIndex;
+    }
+    qsort(pairs, m, 2 * sizeof(int), compareIntPairs);
+
+    // 간선이 양방향이라 호선의 역은 모두 출발역으로 한 번 이상 나온다
+    int* ids = (int*)malloc(sizeof(int) * (m > 0 ? m : 1));
+    int* first = (int*)malloc(sizeof(int) * (m + 1));
+    int* degree = (int*)malloc(sizeof(int) * (m > 0 ? m : 1));
+    int n = 0;
+    for (int i = 0; i < m; i++) {
+        if (i == 0 || pairs[2 * i] != pairs[2 * i - 2]) {
+            ids[n] = pairs[2 * i];
+            first[n] = i;
+            degree[n] = 0;
+            n++;
+        }
+        if (pairs[2 * i + 1] != pairs[2 * i] && (i == first[n - 1] || pairs[2 * i + 1] != pairs[2 * i - 1])) degree[n - 1]++;
+    }
+    first[n] = m;
+
+    char* visited = (char*)calloc(n ? n : 1, 1);
+    int* stack = (int*)malloc(sizeof(int) * (m + 1));
+    int* parent = (int*)malloc(sizeof(int) * (m + 1));  // stack과 같은 칸: 그 역을 넣은 이웃 역 (구간 첫 역은 -1)
+    entry->sequence = (int*)realloc(entry->sequence, sizeof(int) * (n > 0 ? n : 1));
+    entry->segmentFrom = (int*)realloc(entry->segmentFrom, sizeof(int) * (n > 0 ? n : 1));
+    entry->sequenceCount = 0;
+    while (entry->sequenceCount < n) {
+        int start = -1;
+        for (int u = 0; u < n && start == -1; u++)
+            if (!visited[u] && degree[u] <= 1) start = u;
+        for (int u = 0; u < n && start == -1; u++)
+            if (!visited[u]) start = u;
+
+        int top = 0;
+        parent[top] = -1;
+        stack[top++] = start;
+        while (top > 0) {
+            top--;
+            int u = stack[top];
+            if (visited[u]) continue;
+            visited[u] = 1;
+            int last = entry->sequenceCount;
+            entry->segmentFrom[last] = (last > 0 && parent[top] == entry->sequence[last - 1]) ? -2 : parent[top];
+            entry->sequence[entry->sequenceCount++] = ids[u];
+            for (int i = first[u + 1] - 1; i >= first[u]; i--) {  // 번호가 작은 이웃부터 꺼내도록 거꾸로 넣음
+                int* found = (int*)bsearch(&pairs[2 * i + 1], ids, n, sizeof(int), compareInt);
+                if (found && !visited[found - ids]) {
+                    parent[top] = ids[u];
+                    stack[top++] = (int)(found - ids);
+                }
+            }
+        }
+    }
+    entry->sequenceValid = 1;
+    free(pairs);
+    free(ids);
+    free(first);
+    free(degree);
+    free(visited);
+    free(stack);
+    free(parent);
+}
+
+// 호선의 역 목록 (종점부터 순서대로). 없는 호선이면 NULL.
+// segmentFrom이 NULL이 아니면 구간 표시(LineEntry.segmentFrom)도 같이 돌려준다
+const int* lineStations(int line, int* count, const int** segmentFrom) {
+    ensureEdgeLists();
+    LineEntry* entry = findLineEntry(line, 0);
+    *count = 0;
+    if (!entry || entry->count == 0) return NULL;
+    if (!entry->sequenceValid) buildLineSequence(entry);
+    *count = entry->sequenceCount;
+    if (segmentFrom) *segmentFrom = entry->segmentFrom;
+    return entry->sequence;
+}
+
+// 지운 역을 빼고 남은 역의 번호를 앞으로 당김 (지운 역이 많이 쌓였을 때, 스냅샷 저장 전).
+// 역 번호로 만든 색인은 여기서 옮기거나(ALT 표, 이름 색인) 다음 길찾기 때 다시 만든다(CSR부터)
+void compactStations() {
+    if (deletedStationCount == 0) return;
+    ensureEdgeLists();
+    int oldCount = stationCount;
+    int* remap = (int*)malloc(sizeof(int) * (oldCount > 0 ? oldCount : 1));
+    int kept = 0;
+    for (int i = 0; i < oldCount; i++) {
+        if (stations[i].deleted) {
+            remap[i] = -1;
+            continue;
+        }
+        remap[i] = kept;
+        stations[kept++] = stations[i];
+    }
+    for (int i = 0; i < kept; i++)
+        for (SubwayEdge* e = stations[i].edge; e; e = e->next) e->destIndex = remap[e->destIndex];
+    for (int l = 0; l < lineEntryCount; l++) {
+        for (int i = 0; i < lineEntries[l].count; i++) lineEntries[l].edges[i].from = remap[lineEntries[l].edges[i].from];
+        lineEntries[l].sequenceValid = 0;
+    }
+    for (int i = 0; i < disruptionCount; i++) {
+        disruptions[i].from = remap[disruptions[i].from];
+        disruptions[i].to = remap[disruptions[i].to];
+    }
+    stationCount = kept;
+    deletedStationCount = 0;
+    rebuildNameIndex();
+    remapLandmarks(remap, oldCount, kept);
+    graphDirty = 1;
+    free(remap);
+}
+
+// 역 삭제. 간선은 항상 양방향으로 들어가므로 지울 역의 간선 리스트가 곧 그 역으로 들어오는 간선의 출발역 목록이다.
+// 이웃 역 리스트에서만 간선을 빼고, 역은 번호를 그대로 둔 채 지운 표시만 한다 (O(이웃 역 간선 수))
+void removeStation(int target) {
+    ensureEdgeLists();
+    dropDisruptions(target, -1);
+    for (SubwayEdge* e = stations[target].edge; e; e = e->next) {
+        if (e->destIndex == target) continue;
+        SubwayEdge** edgePtr = &stations[e->destIndex].edge;
+        while (*edgePtr) {
+            if ((*edgePtr)->destIndex == target) {
+                SubwayEdge* temp = *edgePtr;
+                *edgePtr = (*edgePtr)->next;
+                lineIndexRemove(temp);
+                freeEdge(temp);
+            }
+            else {
+                edgePtr = &(*edgePtr)->next;
+            }
+        }
+    }
+    for (SubwayEdge* e = stations[target].edge; e; e = e->next) lineIndexRemove(e);
+    freeEdgeList(stations[target].edge);
+    stations[target].edge = NULL;
+    stations[target].deleted = 1;
+    deletedStationCount++;
+    nameIndexRemove(target);
+    graphDirty = 1;
+    if (deletedStationCount >= STATION_COMPACT_MIN && deletedStationCount * 4 > stationCount) compactStations();
+}
+
+// ---------------------- 스냅샷 ----------------------
+
+// 불러온 노선도를 그대로 덤프한 바이너리 파일. 시작할 때 매핑만 하면 역 이름과 CSR을 파일에서 바로 쓴다
+// (파싱 없음, 역 배열과 이름 색인만 채움). 역별 간선 리스트는 편집할 때 CSR에서 만든다.
+// 파일 형식: 헤더 + 8바이트 단위로 정렬한 구역들. 헤더 뒤 전체 내용의 해시를 헤더에 적어 둔다
+#define SNAPSHOT_VERSION 4
+
+#define SNAP_NAMES 0          // 역 이름과 환승 규칙 역 이름 (NUL로 끝나게 이어 붙임)
+#define SNAP_NAME_OFFSETS 1   // int[V]: 역 이름 위치
+#define SNAP_NAME_HASHES 2    // unsigned[V]
+#define SNAP_OFFSETS 3        // CSR
+#define SNAP_DEST 4
+#define SNAP_TIME 5
+#define SNAP_DISTANCE 6
+#define SNAP_LINE 7
+#define SNAP_TRANSFERS 8      // SnapshotTransfer[]
+#define SNAP_CH_EDGES 9       // CH 축약 구조 (두 모드가 같이 씀, 비용은 불러와서 채운다)
+#define SNAP_CH_UP_OFFSETS 10
+#define SNAP_CH_UP_EDGES 11
+#define SNAP_CH_DOWN_OFFSETS 12
+#define SNAP_CH_DOWN_EDGES 13
+#define SNAP_LANDMARKS 14     // 모드마다 ALT 표 (SNAP_LANDMARKS + mode - 1)
+#define SNAPSHOT_SECTIONS 16
+
+#define SNAP_HAS_CH 1         // sections 비트: 1 CH, (2 << (mode - 1)) ALT 표
+#define SNAP_HAS_LANDMARKS 2
+
+typedef struct SnapshotHeader {
+    char magic[4];            // "SDSN"
+    int version;
+    int headerSize;           // 구조체 배치가 같은 빌드에서 쓴 파일인지 확인
+    int chEdgeSize;
+    unsigned checksum;
+    int stationCount;
+    int edgeCount;
+    int transferCount;
+    int sections;
+    unsigned chFingerprint;
+    int chNodeCount;
+    int chEdgeCount;
+    int landmarkCount[2];
+    int landmarks[2][ALT_LANDMARKS];
+    // 스냅샷을 만들 때 읽은 파일들의 크기/수정 시각 (하나라도 바뀌었으면 스냅샷을 쓰지 않음, 없는 파일은 -1)
+    long long sourceSize;     // 노선도 경로 (CSV, 디렉터리 또는 목록 파일)
+    long long sourceTime;
+    long long transferSize;   // transfer_time.csv (환승 규칙도 스냅샷에 들어 있음)
+    long long transferTime;
+    unsigned memberStamp;     // 디렉터리/목록 파일이 가리키는 CSV마다 경로, 크기, 수정 시각을 이은 해시
+    int memberCount;
+    int journalMerged;        // 노선도 파일에는 없고 이 스냅샷에만 있는 변경 기록이 합쳐져 있음
+    long long fileSize;
+    long long offset[SNAPSHOT_SECTIONS];
+    long long length[SNAPSHOT_SECTIONS];
+} SnapshotHeader;
+
+typedef struct SnapshotTransfer {
+    int name;                 // SNAP_NAMES 안의 위치
+    int fromLine;
+    int toLine;
+    float minutes;
+} SnapshotTransfer;
+
+int snapshotVersion = -1;     // 마지막으로 저장/불러온 스냅샷의 graphVersion
+int snapshotSections = 0;
+int journalMerged = 0;        // 지금 노선도에 스냅샷으로만 남은 변경 기록이 들어 있는지 (디렉터리/목록 파일 압축)
+
+// 파일(또는 디렉터리) 크기와 수정 시각
+int fileStamp(const char* path, long long* size, long long* modified) {
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data)) return 0;
+    *size = ((long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    *modified = ((long long)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+#else
+    struct stat st;
+    if (stat(path, &st) != 0) return 0;
+    *size = (long long)st.st_size;
+    *modified = (long long)st.st_mtime;
+#endif
+    return 1;
+}
+
+// 노선도를 만든 파일들의 크기/수정 시각을 header에 채움. 디렉터리는 파일을 고쳐도 디렉터리 수정 시각이
+// 그대로라 안에 든 CSV를 하나씩 본다
+void stampSources(SnapshotHeader* header, const char* source) {
+    header->sourceSize = header->sourceTime = -1;
+    fileStamp(source, &header->sourceSize, &header->sourceTime);
+    header->transferSize = header->transferTime = -1;
+    fileStamp(TRANSFER_FILE, &header->transferSize, &header->transferTime);
+    header->memberStamp = 2166136261u;
+    header->memberCount = 0;
+    size_t length = strlen(source);
+    if (length >= 4 && strcmp(source + length - 4, ".csv") == 0) return;
+
+    char** names;
+    int count = isDirectory(source) ? listNetworkDirectory(source, &names) : readManifest(source, &names);
+    for (int i = 0; i < count; i++) {
+        long long stamp[2] = { -1, -1 };
+        fileStamp(names[i], &stamp[0], &stamp[1]);
+        header->memberStamp = hashBytes(header->memberStamp, names[i], strlen(names[i]) + 1);
+        header->memberStamp = hashBytes(header->memberStamp, stamp, sizeof(stamp));
+        free(names[i]);
+    }
+    free(names);
+    header->memberCount = count;
+}
+
+// 지금 메모리에 있는 색인 중 스냅샷에 넣을 수 있는 것 (SNAP_HAS_* 비트)
+int currentSnapshotSections() {
+    int sections = 0;
+    if (hierarchy.version == graphVersion && routeGraph.version == graphVersion && hierarchy.fingerprint == routeGraph.fingerprint)
+        sections |= SNAP_HAS_CH;
+    for (int m = 0; m < 2; m++)
+        if (landmarkTables[m].valid && !landmarksStale && landmarkTables[m].stationCount == stationCount)
+            sections |= SNAP_HAS_LANDMARKS << m;
+    return sections;
+}
+
+// 헤더 뒤 내용의 해시. 구역이 8바이트 단위라 4바이트씩 묶어서 FNV-1a를 돌린다
+unsigned snapshotChecksum(const char* data, size_t size) {
+    unsigned h = 2166136261u;
+    for (size_t i = 0; i + 4 <= size; i += 4) {
+        unsigned word;
+        memcpy(&word, data + i, 4);
+        h ^= word;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// 구역 하나를 쓰고 8바이트 경계까지 채움
+void writeSnapshotSection(FILE* file, SnapshotHeader* header, int section, const void* data, size_t size) {
+    static const char padding[8] = { 0 };
+    header->offset[section] = ftell(file);
+    header->length[section] = (long long)size;
+    if (size) fwrite(data, 1, size, file);
+    fwrite(padding, 1, (8 - size % 8) % 8, file);
+}
+
+// 스냅샷 매핑을 가리키던 역 이름과 CSR을 메모리로 옮기고 매핑을 놓음 (같은 파일을 다시 쓰기 전에)
+void detachSnapshot() {
+    if (!snapshotFile.data) return;
+    for (int i = 0; i < stationCount; i++)
+        stations[i].name = internName(stations[i].name, strlen(stations[i].name));
+    for (int r = 0; r < transferRuleCount; r++)
+        transferRules[r].station = internName(transferRules[r].station, strlen(transferRules[r].station));
+    if (graph.mapped) buildGraph();
+    releaseSnapshot();
+}
+
+// 지금 노선도를 스냅샷으로 저장. source는 노선도 파일 경로 (다음 시작 때 바뀌었는지 비교).
+// 임시 파일에 다 쓰고 fsync한 뒤 바꿔 넣으므로 중간에 끊겨도 예전 스냅샷은 남는다. 바꿔 넣었으면 1
+int saveSnapshot(const char* filename, const char* source) {
+    detachSnapshot();
+    compactStations();  // 파일에는 지운 역을 남기지 않는다
+    ensureGraph();
+    int V = stationCount, E = graph.edgeCount;
+    char tempName[1024];
+    snprintf(tempName, sizeof(tempName), "%s.tmp", filename);
+    FILE* file = fopen(tempName, "wb");
+    if (!file) {
+        printf("스냅샷을 저장할 수 없습니다: %s\n", filename);
+        return 0;
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "SDSN", 4);
+    header.version = SNAPSHOT_VERSION;
+    header.headerSize = sizeof(SnapshotHeader);
+    header.chEdgeSize = sizeof(ChEdge);
+    header.stationCount = V;
+    header.edgeCount = E;
+    header.transferCount = transferRuleCount;
+    header.sections = currentSnapshotSections();
+    stampSources(&header, source);
+    header.journalMerged = journalMerged;
+    fwrite(&header, sizeof(header), 1, file);
+
+    // 이름 저장소: 역 이름 뒤에 환승 규칙 역 이름
+    size_t poolSize = 0;
+    for (int i = 0; i < V; i++) poolSize += strlen(stations[i].name) + 1;
+    for (int r = 0; r < transferRuleCount; r++) poolSize += strlen(transferRules[r].station) + 1;
+    char* pool = (char*)malloc(poolSize ? poolSize : 1);
+    int* nameOffsets = (int*)malloc(sizeof(int) * (V ? V : 1));
+    unsigned* hashes = (unsigned*)malloc(sizeof(unsigned) * (V ? V : 1));
+    SnapshotTransfer* transfers = (SnapshotTransfer*)malloc(sizeof(SnapshotTransfer) * (transferRuleCount ? transferRuleCount : 1));
+    size_t used = 0;
+    for (int i = 0; i < V; i++) {
+        size_t length = strlen(stations[i].name) + 1;
+        memcpy(pool + used, stations[i].name, length);
+        nameOffsets[i] = (int)used;
+        hashes[i] = stations[i].hash;
+        used += length;
+    }
+    for (int r = 0; r < transferRuleCount; r++) {
+        size_t length = strlen(transferRules[r].station) + 1;
+        memcpy(pool + used, transferRules[r].station, length);
+        transfers[r].name = (int)used;
+        transfers[r].fromLine = transferRules[r].fromLine;
+        transfers[r].toLine = transferRules[r].toLine;
+        transfers[r].minutes = transferRules[r].minutes;
+        used += length;
+    }
+
+    writeSnapshotSection(file, &header, SNAP_NAMES, pool, poolSize);
+    writeSnapshotSection(file, &header, SNAP_NAME_OFFSETS, nameOffsets, sizeof(int) * V);
+    writeSnapshotSection(file, &header, SNAP_NAME_HASHES, hashes, sizeof(unsigned) * V);
+    writeSnapshotSection(file, &header, SNAP_OFFSETS, graph.offsets, sizeof(int) * (V + 1));
+    writeSnapshotSection(file, &header, SNAP_DEST, graph.destIndex, sizeof(int) * E);
+    writeSnapshotSection(file, &header, SNAP_TIME, graph.time, sizeof(float) * E);
+    writeSnapshotSection(file, &header, SNAP_DISTANCE, graph.distance, sizeof(float) * E);
+    writeSnapshotSection(file, &header, SNAP_LINE, graph.line, sizeof(int) * E);
+    writeSnapshotSection(file, &header, SNAP_TRANSFERS, transfers, sizeof(SnapshotTransfer) * transferRuleCount);
+
+    if (header.sections & SNAP_HAS_CH) {
+        const ContractionHierarchy* ch = &hierarchy;
+        int N = ch->nodeCount;
+        header.chFingerprint = ch->fingerprint;
+        header.chNodeCount = N;
+        header.chEdgeCount = ch->edgeCount;
+        writeSnapshotSection(file, &header, SNAP_CH_EDGES, ch->edges, sizeof(ChEdge) * ch->edgeCount);
+        writeSnapshotSection(file, &header, SNAP_CH_UP_OFFSETS, ch->upOffsets, sizeof(int) * (N + 1));
+        writeSnapshotSection(file, &header, SNAP_CH_UP_EDGES, ch->upEdges, sizeof(int) * ch->upOffsets[N]);
+        writeSnapshotSection(file, &header, SNAP_CH_DOWN_OFFSETS, ch->downOffsets, sizeof(int) * (N + 1));
+        writeSnapshotSection(file, &header, SNAP_CH_DOWN_EDGES, ch->downEdges, sizeof(int) * ch->downOffsets[N]);
+    }
+    for (int m = 0; m < 2; m++) {
+        if (header.sections & (SNAP_HAS_LANDMARKS << m)) {
+            const LandmarkTable* table = &landmarkTables[m];
+            header.landmarkCount[m] = table->count;
+            memcpy(header.landmarks[m], table->landmarks, sizeof(table->landmarks));
+            writeSnapshotSection(file, &header, SNAP_LANDMARKS + m, table->dist, sizeof(float) * V * ALT_LANDMARKS);
+        }
+    }
+
+    // 다 쓴 파일을 다시 매핑해서 해시를 구한 뒤 헤더를 채운다
+    header.fileSize = ftell(file);
+    int ok = !ferror(file);
+    if (fclose(file) != 0) ok = 0;
+    MappedFile written;
+    if (ok && (ok = mapFile(&written, tempName))) {
+        header.checksum = snapshotChecksum(written.data + sizeof(SnapshotHeader), written.size - sizeof(SnapshotHeader));
+        unmapFile(&written);
+    }
+    file = ok ? fopen(tempName, "r+b") : NULL;
+    ok = file != NULL;
+    if (file) {
+        ok = fwrite(&header, sizeof(header), 1, file) == 1;
+        ok = syncFile(file) && ok;
+        if (fclose(file) != 0) ok = 0;
+    }
+    ok = ok && replaceFile(tempName, filename);
+    free(pool);
+    free(nameOffsets);
+    free(hashes);
+    free(transfers);
+    if (!ok) {
+        printf("스냅샷을 저장할 수 없습니다: %s\n", filename);
+        remove(tempName);
+        return 0;
+    }
+    snapshotVersion = graphVersion;
+    snapshotSections = header.sections;
+    return 1;
+}
+
+// 구역이 파일 안에 있고 기대한 크기인지
+int snapshotSectionOk(const SnapshotHeader* header, int section, long long size) {
+    return header->offset[section] >= (long long)sizeof(SnapshotHeader) && header->offset[section] % 8 == 0
+        && header->length[section] == size && header->offset[section] + size <= header->fileSize;
+}
+
+const void* snapshotSection(const SnapshotHeader* header, int section) {
+    return (const char*)header + header->offset[section];
+}
+
+// 스냅샷 불러오기. 파일이 없거나, 손상됐거나, 노선도/환승 시간 파일이 그 뒤로 바뀌었으면 0
+int loadSnapshot(const char* filename, const char* source) {
+    MappedFile mf;
+    if (!mapFile(&mf, filename)) return 0;
+
+    const SnapshotHeader* header = (const SnapshotHeader*)mf.data;
+    SnapshotHeader sources;
+    stampSources(&sources, source);
+    int V = 0, E = 0, T = 0;
+    int ok = mf.size >= sizeof(SnapshotHeader) && memcmp(header->magic, "SDSN", 4) == 0
+        && header->version == SNAPSHOT_VERSION && header->headerSize == (int)sizeof(SnapshotHeader)
+        && header->chEdgeSize == (int)sizeof(ChEdge) && header->fileSize == (long long)mf.size;
+    if (ok && !(header->sourceSize == sources.sourceSize && header->sourceTime == sources.sourceTime
+        && header->transferSize == sources.transferSize && header->transferTime == sources.transferTime
+        && header->memberStamp == sources.memberStamp && header->memberCount == sources.memberCount)) {
+        if (header->journalMerged)
+            printf("노선도 파일이 바뀌어 스냅샷에 합쳐 두었던 변경 기록은 적용되지 않습니다: %s\n", filename);
+        ok = 0;
+    }
+    if (ok) {
+        V = header->stationCount;
+        E = header->edgeCount;
+        T = header->transferCount;
+        ok = V >= 0 && E >= 0 && T >= 0
+            && snapshotSectionOk(header, SNAP_NAMES, header->length[SNAP_NAMES])
+            && snapshotSectionOk(header, SNAP_NAME_OFFSETS, sizeof(int) * (long long)V)
+            && snapshotSectionOk(header, SNAP_NAME_HASHES, sizeof(unsigned) * (long long)V)
+            && snapshotSectionOk(header, SNAP_OFFSETS, sizeof(int) * ((long long)V + 1))
+            && snapshotSectionOk(header, SNAP_DEST, sizeof(int) * (long long)E)
+            && snapshotSectionOk(header, SNAP_TIME, sizeof(float) * (long long)E)
+            && snapshotSectionOk(header, SNAP_DISTANCE, sizeof(float) * (long long)E)
+            && snapshotSectionOk(header, SNAP_LINE, sizeof(int) * (long long)E)
+            && snapshotSectionOk(header, SNAP_TRANSFERS, sizeof(SnapshotTransfer) * (long long)T);
+    }
+    if (ok && (header->sections & SNAP_HAS_CH)) {
+        long long N = header->chNodeCount;
+        ok = N >= 0 && header->chEdgeCount >= 0
+            && snapshotSectionOk(header, SNAP_CH_EDGES, sizeof(ChEdge) * (long long)header->chEdgeCount)
+            && snapshotSectionOk(header, SNAP_CH_UP_OFFSETS, sizeof(int) * (N + 1))
+            && snapshotSectionOk(header, SNAP_CH_UP_EDGES, header->length[SNAP_CH_UP_EDGES])
+            && snapshotSectionOk(header, SNAP_CH_DOWN_OFFSETS, sizeof(int) * (N + 1))
+            && snapshotSectionOk(header, SNAP_CH_DOWN_EDGES, header->length[SNAP_CH_DOWN_EDGES]);
+    }
+    for (int m = 0; ok && m < 2; m++)
+        if (header->sections & (SNAP_HAS_LANDMARKS << m))
+            ok = header->landmarkCount[m] >= 0 && header->landmarkCount[m] <= ALT_LANDMARKS
+                && snapshotSectionOk(header, SNAP_LANDMARKS + m, sizeof(float) * (long long)V * ALT_LANDMARKS);
+    if (ok) {
+        // 헤더 뒤 전체 내용 확인 (파일을 처음부터 끝까지 한 번 읽는 유일한 곳)
+        ok = snapshotChecksum(mf.data + sizeof(SnapshotHeader), mf.size - sizeof(SnapshotHeader)) == header->checksum;
+    }
+    if (!ok) {
+        unmapFile(&mf);
+        return 0;
+    }
+
+    resetNetwork();
+    snapshotFile = mf;
+
+    // 역 이름은 파일 안의 문자열을 그대로 가리킨다
+    const char* names = (const char*)snapshotSection(header, SNAP_NAMES);
+    const int* nameOffsets = (const int*)snapshotSection(header, SNAP_NAME_OFFSETS);
+    const unsigned* hashes = (const unsigned*)snapshotSection(header, SNAP_NAME_HASHES);
+    if (V > stationCapacity) {
+        stationCapacity = V;
+        stations = (Station*)realloc(stations, sizeof(Station) * stationCapacity);
+    }
+    for (int i = 0; i < V; i++) {
+        stations[i].name = names + nameOffsets[i];
+        stations[i].hash = hashes[i];
+        stations[i].edge = NULL;
+        stations[i].deleted = 0;
+    }
+    stationCount = V;
+    rebuildNameIndex();
+
+    const SnapshotTransfer* transfers = (const SnapshotTransfer*)snapshotSection(header, SNAP_TRANSFERS);
+    if (T > transferRuleCapacity) {
+        transferRuleCapacity = T;
+        transferRules = (TransferRule*)realloc(transferRules, sizeof(TransferRule) * transferRuleCapacity);
+    }
+    for (int r = 0; r < T; r++) {
+        transferRules[r].station = names + transfers[r].name;
+        transferRules[r].fromLine = transfers[r].fromLine;
+        transferRules[r].toLine = transfers[r].toLine;
+        transferRules[r].minutes = transfers[r].minutes;
+    }
+    transferRuleCount = T;
+
+    // CSR도 파일을 그대로 가리킨다 (편집하면 buildGraph가 새 배열로 옮김)
+    free(graph.offsets);
+    free(graph.destIndex);
+    free(graph.time);
+    free(graph.distance);
+    free(graph.line);
+    graph.offsets = (int*)snapshotSection(header, SNAP_OFFSETS);
+    graph.destIndex = (int*)snapshotSection(header, SNAP_DEST);
+    graph.time = (float*)snapshotSection(header, SNAP_TIME);
+    graph.distance = (float*)snapshotSection(header, SNAP_DISTANCE);
+    graph.line = (int*)snapshotSection(header, SNAP_LINE);
+    graph.stationCount = V;
+    graph.edgeCount = E;
+    graph.edgeCapacity = 0;
+    graph.mapped = 1;
+    graphDirty = 0;
+    graphVersion++;
+    edgeListsStale = 1;
+
+    // 전처리 색인은 복사해서 쓴다 (다시 만들거나 편집할 때 그냥 free/realloc 하도록)
+    landmarksStale = 0;
+    ContractionHierarchy* ch = &hierarchy;
+    freeHierarchy(ch);
+    if (header->sections & SNAP_HAS_CH) {
+        int N = header->chNodeCount;
+        ch->fingerprint = header->chFingerprint;
+        ch->nodeCount = N;
+        ch->edgeCount = header->chEdgeCount;
+        ch->edges = (ChEdge*)malloc(header->length[SNAP_CH_EDGES] + 1);
+        ch->upOffsets = (int*)malloc(header->length[SNAP_CH_UP_OFFSETS]);
+        ch->upEdges = (int*)malloc(header->length[SNAP_CH_UP_EDGES] + 1);
+        ch->downOffsets = (int*)malloc(header->length[SNAP_CH_DOWN_OFFSETS]);
+        ch->downEdges = (int*)malloc(header->length[SNAP_CH_DOWN_EDGES] + 1);
+        memcpy(ch->edges, snapshotSection(header, SNAP_CH_EDGES), header->length[SNAP_CH_EDGES]);
+        memcpy(ch->upOffsets, snapshotSection(header, SNAP_CH_UP_OFFSETS), header->length[SNAP_CH_UP_OFFSETS]);
+        memcpy(ch->upEdges, snapshotSection(header, SNAP_CH_UP_EDGES), header->length[SNAP_CH_UP_EDGES]);
+        memcpy(ch->downOffsets, snapshotSection(header, SNAP_CH_DOWN_OFFSETS), header->length[SNAP_CH_DOWN_OFFSETS]);
+        memcpy(ch->downEdges, snapshotSection(header, SNAP_CH_DOWN_EDGES), header->length[SNAP_CH_DOWN_EDGES]);
+        ch->version = graphVersion;
+    }
+    for (int m = 0; m < 2; m++) {
+        LandmarkTable* table = &landmarkTables[m];
+        table->valid = 0;
+        if (header->sections & (SNAP_HAS_LANDMARKS << m)) {
+            table->count = header->landmarkCount[m];
+            table->stationCount = V;
+            memcpy(table->landmarks, header->landmarks[m], sizeof(table->landmarks));
+            table->dist = (float*)realloc(table->dist, sizeof(float) * (V ? V : 1) * ALT_LANDMARKS);
+            memcpy(table->dist, snapshotSection(header, SNAP_LANDMARKS + m), sizeof(float) * V * ALT_LANDMARKS);
+            table->valid = 1;
+        }
+    }
+
+    snapshotVersion = graphVersion;
+    snapshotSections = header->sections;
+    journalMerged = header->journalMerged;
+    return 1;
+}
+
+// 마지막 저장 이후 노선도가 바뀌었거나 새 색인이 생겼으면 다시 저장
+void updateSnapshot(const char* filename, const char* source) {
+    if (stationCount == 0) return;
+    ensureGraph();
+    if (snapshotVersion == graphVersion && snapshotSections == currentSnapshotSections()) return;
+    saveSnapshot(filename, source);
+}
+
+// ---------------------- 변경 기록 (journal) ----------------------
+
+// 편집(간선 추가, 호선 삭제, 역 삭제)은 노선도 CSV를 다시 쓰지 않고 변경 기록 파일 끝에 한 줄씩 덧붙인다.
+// 기록 한 줄: 종류,내용...,체크섬(16진수). 체크섬이 맞지 않거나 줄바꿈 없이 끊긴 마지막 줄은 버린다.
+//   A,호선,출발역,도착역,거리(km),시간(분)   간선 추가 (양방향, 같은 간선이 이미 있으면 건너뜀)
+//   L,호선                                   호선 삭제
+//   S,역                                     역 삭제 (자동 연결 간선은 앞에 A로 따로 적음)
+//   P,호선 / R,호선                          호선 운행 중지 / 재개
+// 세 가지 모두 여러 번 적용해도 결과가 같으므로, 시작할 때 노선도(또는 스냅샷) 위에 기록 전체를 다시 적용한다.
+// 기록이 커지면 백그라운드 스레드가 지금 노선도를 새 CSV로 써서 노선도 파일과 바꾸고, 그 사이에 쌓인 기록만 남긴다.
+// 노선도가 디렉터리/목록 파일이면 어느 CSV에 써야 할지 모르므로, 메뉴 하나가 끝난 뒤 지금 노선도를 스냅샷으로 써서
+// 압축한다 (그 뒤로는 스냅샷이 노선도 파일 + 합친 기록이고, 노선도 파일이 바뀌어 스냅샷을 못 쓰면 합친 기록도 잃는다).
+// 운행 중지는 CSV에 적을 수 없으므로 압축한 뒤 새 기록 파일 앞에 지금 중지된 호선의 P 기록을 다시 적는다
+// 기록은 JOURNAL_SYNC_BATCH개나 JOURNAL_SYNC_SECONDS초마다 묶어서 fsync하고, 메뉴 하나가 끝나면 남은 것도 fsync한다
+// (다음 입력을 기다리는 동안 fsync하지 않은 기록을 남겨 두지 않는다)
+#define JOURNAL_SYNC_BATCH 16              // fsync 없이 쌓아 두는 기록 수
+#define JOURNAL_SYNC_SECONDS 1             // 마지막 fsync 뒤 이만큼 지났으면 바로 fsync
+#define JOURNAL_COMPACT_BYTES (64 * 1024)  // 기록 파일이 이보다 커지면 압축 시작
+#define JOURNAL_MAX_RECORD 512
+
+typedef struct ChangeJournal {
+    char path[1024];
+    char basePath[1024];       // 압축할 때 새로 쓸 노선도 CSV (디렉터리/목록 파일이면 비워 두고 스냅샷으로 압축)
+    char sourcePath[1024];     // 노선도 경로와 스냅샷 경로 (스냅샷으로 압축할 때)
+    char snapshotPath[1024];
+    FILE* file;
+    long long size;            // 유효한 기록의 끝
+    int pending;               // 아직 fsync하지 않은 기록 수
+    time_t lastSync;
+    int compacting;
+    volatile long compactDone;
+    int compactOk;
+    long long compactOffset;   // 새 노선도 파일에 들어간 기록의 끝
+    long long carried;         // 압축 뒤 다시 적은 P 기록 크기 (기록이 이것뿐이면 압축할 것이 없음)
+    char* compactText;
+    size_t compactLength;
+    WorkerThread compactThread;
+} ChangeJournal;
+
+ChangeJournal journal;
+
+void syncJournal() {
+    if (!journal.file || journal.pending == 0) return;
+    syncFile(journal.file);
+    journal.pending = 0;
+    journal.lastSync = time(NULL);
+}
+
+// 예전 기록은 소수 둘째 자리까지만 적었으므로 그 안에서 같으면 같은 값으로 본다
+int sameRecordedValue(float a, float b) {
+    return (a > b ? a - b : b - a) < 0.006f;
+}
+
+// from -> to 간선이 이미 있는지
+int hasEdge(int from, int to, float time, float distance, int line) {
+    for (SubwayEdge* e = stations[from].edge; e; e = e->next)
+        if (e->destIndex == to && e->line == line && sameRecordedValue(e->time, time) && sameRecordedValue(e->distance, distance))
+            return 1;
+    return 0;
+}
+
+// 양방향 간선 추가. 같은 간선이 있는 방향은 건너뜀 (기록을 다시 적용해도 간선이 늘지 않게)
+void addEdgeOnce(int from, int to, float time, float distance, int line) {
+    ensureEdgeLists();
+    if (!hasEdge(from, to, time, distance, line)) addEdge(from, to, time, distance, line);
+    if (!hasEdge(to, from, time, distance, line)) addEdge(to, from, time, distance, line);
+    landmarksStale = 1;  // 새 간선으로 거리가 줄어들 수 있음
+}
+
+// 기록 한 줄의 체크섬 (체크섬 필드 앞 쉼표 전까지)
+unsigned journalChecksum(const char* text, size_t length) {
+    return hashBytes(2166136261u, text, length);
+}
+
+// 기록 한 줄을 record에 만듦 (줄바꿈 포함). 길이를 돌려줌
+int formatJournalRecord(const char* body, char* record, size_t size) {
+    return snprintf(record, size, "%s,%08x\n", body, journalChecksum(body, strlen(body)));
+}
+
+// 기록 파일을 data로 통째로 바꿈 (임시 파일에 쓰고 fsync한 뒤 이름 바꾸기). 열려 있던 파일은 닫고 다시 연다
+int rewriteJournal(const char* data, size_t length) {
+    if (journal.file) {
+        syncJournal();
+        fclose(journal.file);
+        journal.file = NULL;
+    }
+    char tempName[1040];
+    snprintf(tempName, sizeof(tempName), "%s.tmp", journal.path);
+    FILE* file = fopen(tempName, "wb");
+    int ok = file != NULL;
+    if (file) {
+        if (length) ok = fwrite(data, 1, length, file) == length;
+        ok = syncFile(file) && ok;
+        fclose(file);
+    }
+    if (ok) {
+        ok = replaceFile(tempName, journal.path);
+    }
+    journal.file = fopen(journal.path, "ab");
+    if (ok) journal.size = (long long)length;
+    return ok;
+}
+
+// 노선도 CSV를 새로 쓰는 백그라운드 작업 (글은 메인 스레드가 미리 만들어 둠)
+void compactWorker(void* arg) {
+    (void)arg;
+    char tempName[1040];
+    snprintf(tempName, sizeof(tempName), "%s.tmp", journal.basePath);
+    FILE* file = fopen(tempName, "wb");
+    int ok = file != NULL;
+    if (file) {
+        ok = fwrite(journal.compactText, 1, journal.compactLength, file) == journal.compactLength;
+        ok = syncFile(file) && ok;
+        fclose(file);
+    }
+    if (ok) {
+        ok = replaceFile(tempName, journal.basePath);
+    }
+    journal.compactOk = ok;
+    atomicAdd(&journal.compactDone, 1);
+}
+
+// 지금 노선도를 CSV 글로 만듦 (노선도 파일의 인코딩으로). 양방향 간선은 번호가 작은 역 쪽에서 한 번만 쓴다
+char* formatNetworkCSV(const char* basePath, size_t* length) {
+    ensureEdgeLists();
+    int encoding = fileEncoding(basePath);
+    size_t capacity = 4096, used = 0;
+    char* text = (char*)malloc(capacity);
+    if (encoding == ENCODING_UTF8) used += (size_t)sprintf(text, "\xEF\xBB\xBF");
+    char header[128];
+    const char* columns = "호선,출발역,도착역,거리(km),시간(분)";
+    size_t headerLength = transcode(ENCODING_UTF8, encoding, columns, strlen(columns), header, sizeof(header));
+    memcpy(text + used, header, headerLength);
+    used += headerLength;
+    text[used++] = '\n';
+
+    // 역 이름은 역마다 한 번만 바꿔 둔다
+    char** names = (char**)malloc(sizeof(char*) * (stationCount > 0 ? stationCount : 1));
+    for (int i = 0; i < stationCount; i++) {
+        names[i] = NULL;
+        if (stations[i].deleted) continue;
+        char buffer[MAX_STATION_NAME * 2];
+        size_t n = transcode(ENCODING_UTF8, encoding, stations[i].name, strlen(stations[i].name), buffer, sizeof(buffer) - 1);
+        buffer[n] = '\0';
+        names[i] = (char*)duplicateBlock(buffer, n + 1);
+    }
+    for (int i = 0; i < stationCount; i++) {
+        int selfLoops = 0;
+        for (SubwayEdge* e = stations[i].edge; e; e = e->next) {
+            if (e->destIndex < i) continue;
+            if (e->destIndex == i && selfLoops++ % 2) continue;  // 제자리 간선은 리스트에 두 번 들어 있음
+            if (used + 2 * MAX_STATION_NAME * 2 + 64 > capacity) {
+                capacity *= 2;
+                text = (char*)realloc(text, capacity);
+            }
+            char distance[32], time[32];
+            used += (size_t)sprintf(text + used, "%d,%s,%s,%s,%s\n", e->line, names[i], names[e->destIndex],
+                formatCsvFloat(distance, sizeof(distance), e->distance), formatCsvFloat(time, sizeof(time), e->time));
+        }
+    }
+    for (int i = 0; i < stationCount; i++) free(names[i]);
+    free(names);
+    *length = used;
+    return text;
+}
+
+// 압축 시작: 지금까지의 기록을 모두 반영한 노선도를 새 CSV로 쓴다 (쓰기는 백그라운드 스레드)
+void startCompaction() {
+    if (journal.compacting || !journal.file || journal.basePath[0] == '\0' || journal.size <= journal.carried || stationCount == 0) return;
+    syncJournal();
+    journal.compactText = formatNetworkCSV(journal.basePath, &journal.compactLength);
+    journal.compactOffset = journal.size;
+    journal.compactDone = 0;
+    journal.compactOk = 0;
+    journal.compacting = 1;
+    if (!startThread(&journal.compactThread, compactWorker, NULL)) {
+        compactWorker(NULL);
+        journal.compacting = 2;  // 스레드 없이 끝냄 (join하지 않음)
+    }
+}
+
+// 압축이 끝났으면 마무리: 새 노선도에 들어간 기록을 기록 파일에서 뺀다. wait면 끝날 때까지 기다림
+void finishCompaction(int wait) {
+    if (!journal.compacting) return;
+    if (!wait && atomicAdd(&journal.compactDone, 0) == 0) return;
+    if (journal.compacting == 1) joinThread(&journal.compactThread);
+    journal.compacting = 0;
+    free(journal.compactText);
+    journal.compactText = NULL;
+    if (!journal.compactOk) {
+        if (journal.basePath[0] != '\0') printf("노선도 파일을 새로 쓰지 못했습니다: %s\n", journal.basePath);
+        return;
+    }
+
+    // 운행 중지 중인 호선 기록 + 압축하는 동안 덧붙은 기록만 남긴다
+    syncJournal();
+    MappedFile mf;
+    if (!mapFile(&mf, journal.path)) return;
+    size_t from = (size_t)journal.compactOffset;
+    size_t to = (size_t)journal.size;
+    if (to > mf.size) to = mf.size;
+    if (from > to) from = to;
+    size_t carried = 0;
+    char* text = (char*)malloc((size_t)suspendedLineCount * 32 + (to - from) + 1);
+    for (int i = 0; i < lineEntryCount; i++) {
+        if (!lineEntries[i].suspended || lineEntries[i].count == 0) continue;
+        char body[32];
+        snprintf(body, sizeof(body), "P,%d", lineEntries[i].line);
+        carried += (size_t)formatJournalRecord(body, text + carried, 32);
+    }
+    if (to > from) memcpy(text + carried, mf.data + from, to - from);
+    unmapFile(&mf);
+    if (rewriteJournal(text, carried + (to - from))) journal.carried = (long long)carried;
+    free(text);
+    if (journal.basePath[0] != '\0') snapshotVersion = -1;  // 노선도 파일이 바뀌었으므로 종료할 때 스냅샷도 새로 쓴다
+}
+
+// 디렉터리/목록 파일 노선도의 압축: 지금 노선도를 스냅샷으로 쓰고(fsync까지) 거기 들어간 기록을 뺀다.
+// 스냅샷을 쓰면서 역 번호를 다시 매기므로 역 번호를 들고 있는 편집 도중이 아니라 메뉴 사이에서만 부른다
+void compactIntoSnapshot() {
+    if (journal.compacting || !journal.file || journal.basePath[0] != '\0' || journal.snapshotPath[0] == '\0'
+        || journal.size <= journal.carried || stationCount == 0) return;
+    syncJournal();
+    journal.compactOffset = journal.size;
+    int merged = journalMerged;
+    journalMerged = 1;
+    journal.compactOk = saveSnapshot(journal.snapshotPath, journal.sourcePath);
+    if (!journal.compactOk) journalMerged = merged;
+    journal.compactDone = 1;
+    journal.compacting = 2;
+    finishCompaction(1);
+}
+
+// 기록 한 줄 덧붙이기. 기록을 JOURNAL_SYNC_BATCH개씩 묶어서 fsync하고, 파일이 커지면 압축을 시작한다
+void journalRecord(const char* body) {
+    if (!journal.file) return;
+    char record[JOURNAL_MAX_RECORD + 16];
+    int n = formatJournalRecord(body, record, sizeof(record));
+    if (fwrite(record, 1, (size_t)n, journal.file) != (size_t)n || fflush(journal.file) != 0) {
+        printf("변경 기록을 쓰지 못했습니다: %s\n", journal.path);
+        return;
+    }
+    journal.size += n;
+    journal.pending++;
+    if (journal.pending >= JOURNAL_SYNC_BATCH || time(NULL) - journal.lastSync >= JOURNAL_SYNC_SECONDS) syncJournal();
+
+    finishCompaction(0);
+    if (journal.size >= JOURNAL_COMPACT_BYTES) startCompaction();
+}
+
+// 거리/시간은 다시 읽으면 메모리 값과 똑같아지도록 적는다 (죽은 뒤 다시 적용해도 값이 바뀌지 않게)
+void journalAddEdge(int line, const char* from, const char* to, float distance, float time) {
+    char body[JOURNAL_MAX_RECORD], distanceText[32], timeText[32];
+    snprintf(body, sizeof(body), "A,%d,%s,%s,%s,%s", line, from, to,
+        formatCsvFloat(distanceText, sizeof(distanceText), distance), formatCsvFloat(timeText, sizeof(timeText), time));
+    journalRecord(body);
+}
+
+void journalDeleteLine(int line) {
+    char body[JOURNAL_MAX_RECORD];
+    snprintf(body, sizeof(body), "L,%d", line);
+    journalRecord(body);
+}
+
+void journalSuspendLine(int line, int suspended) {
+    char body[JOURNAL_MAX_RECORD];
+    snprintf(body, sizeof(body), "%c,%d", suspended ? 'P' : 'R', line);
+    journalRecord(body);
+}
+
+void journalDeleteStation(const char* name) {
+    char body[JOURNAL_MAX_RECORD];
+    snprintf(body, sizeof(body), "S,%s", name);
+    journalRecord(body);
+}
+
+// 기록 한 줄 적용. 형식이 맞지 않으면 0
+int applyJournalRecord(const CsvField* fields, int count) {
+    char from[MAX_STATION_NAME * 2], to[MAX_STATION_NAME * 2];
+    if (fields[0].length != 1) return 0;
+    switch (fields[0].text[0]) {
+    case 'A': {
+        if (count != 7 || fields[2].length == 0 || fields[3].length == 0
+            || fields[2].length >= sizeof(from) || fields[3].length >= sizeof(to)) return 0;
+        memcpy(from, fields[2].text, fields[2].length);
+        from[fields[2].length] = '\0';
+        memcpy(to, fields[3].text, fields[3].length);
+        to[fields[3].length] = '\0';
+        int fromIdx = getOrAddStation(from);
+        int toIdx = getOrAddStation(to);
+        addEdgeOnce(fromIdx, toIdx, csvFloat(&fields[5]), csvFloat(&fields[4]), csvInt(&fields[1]));
+        return 1;
+    }
+    case 'L':
+        if (count != 3) return 0;
+        deleteLineEdges(csvInt(&fields[1]));
+        return 1;
+    case 'P':
+    case 'R':
+        if (count != 3) return 0;
+        setLineSuspended(csvInt(&fields[1]), fields[0].text[0] == 'P');
+        return 1;
+    case 'S': {
+        if (count != 3 || fields[1].length >= sizeof(from)) return 0;
+        int target = findStation(fields[1].text, fields[1].length, hashNameLength(fields[1].text, fields[1].length));
+        if (target != -1) removeStation(target);
+        return 1;
+    }
+    }
+    return 0;
+}
+
+// 기록 파일 전체를 지금 노선도에 다시 적용. 끊기거나 체크섬이 틀린 줄이 나오면 거기서 멈추고 파일도 그 앞까지로 자른다.
+// 체크섬은 맞는데 적용할 수 없는 줄은 온전히 적힌 기록이므로 알리고 건너뛴다 (뒤 기록까지 버리지 않게)
+int replayJournal() {
+    finishCompaction(1);
+    if (journal.file) {
+        syncJournal();
+        fclose(journal.file);
+        journal.file = NULL;
+    }
+    journal.size = 0;
+
+    MappedFile mf;
+    int applied = 0, skipped = 0;
+    size_t valid = 0;
+    if (mapFile(&mf, journal.path)) {
+        CsvScanner sc = { mf.data, mf.data + mf.size };
+        CsvField fields[CSV_MAX_FIELDS];
+        int count;
+        while (1) {
+            const char* row = sc.cur;
+            if ((count = csvReadRow(&sc, fields)) == -1) break;
+            if (sc.cur[-1] != '\n') break;  // 끊긴 줄
+            // 체크섬은 필드 수와 상관없이 줄 끝의 마지막 필드에서 읽는다
+            const char* end = sc.cur - 1;
+            if (end > row && end[-1] == '\r') end--;
+            const char* check = end;
+            while (check > row && check[-1] != ',') check--;
+            if (check == row || end - check != 8) break;
+            size_t bodyLength = (size_t)(check - row) - 1;
+            char hex[16];
+            memcpy(hex, check, 8);
+            hex[8] = '\0';
+            if ((unsigned)strtoul(hex, NULL, 16) != journalChecksum(row, bodyLength)) break;
+            valid = (size_t)(sc.cur - mf.data);
+            if (count >= CSV_MAX_FIELDS || !applyJournalRecord(fields, count)) {
+                printf("적용할 수 없는 변경 기록을 건너뜁니다: %.*s\n", (int)bodyLength, row);
+                skipped++;
+                continue;
+            }
+            applied++;
+        }
+        if (valid < mf.size) {
+            printf("변경 기록 뒷부분 %d바이트가 손상되어 버렸습니다.\n", (int)(mf.size - valid));
+            char* prefix = (char*)duplicateBlock(mf.data, valid);
+            unmapFile(&mf);
+            rewriteJournal(prefix, valid);
+            free(prefix);
+        }
+        else unmapFile(&mf);
+    }
+    if (!journal.file) journal.file = fopen(journal.path, "ab");
+    journal.size = (long long)valid;
+    journal.carried = 0;
+    journal.pending = 0;
+    journal.lastSync = time(NULL);
+    if (applied > 0) printf("변경 기록 %d건을 다시 적용했습니다.\n", applied);
+    if (skipped > 0) printf("변경 기록 %d건은 적용하지 못했습니다.\n", skipped);
+    return applied;
+}
+
+// 노선도 경로에 맞춰 기록 파일 경로를 정함 (노선도.journal). CSV 파일 하나면 그 파일로, 아니면 스냅샷으로 압축한다
+void openJournal(const char* networkPath, const char* snapshotPath) {
+    snprintf(journal.path, sizeof(journal.path), "%s.journal", networkPath);
+    snprintf(journal.sourcePath, sizeof(journal.sourcePath), "%s", networkPath);
+    snprintf(journal.snapshotPath, sizeof(journal.snapshotPath), "%s", snapshotPath);
+    size_t length = strlen(networkPath);
+    journal.basePath[0] = '\0';
+    if (length >= 4 && strcmp(networkPath + length - 4, ".csv") == 0)
+        snprintf(journal.basePath, sizeof(journal.basePath), "%s", networkPath);
+}
+
+// 다시 적용할 기록이 있는지 (스냅샷이 없어도 시작할 때 노선도를 읽어 기록을 적용해야 하는지)
+int journalHasRecords() {
+    long long size = 0, modified = 0;
+    return fileStamp(journal.path, &size, &modified) && size > 0;
+}
+
+// 종료할 때: 남은 기록을 노선도에 합치고 기록 파일을 닫음
+void closeJournal() {
+    finishCompaction(1);
+    startCompaction();
+    finishCompaction(1);
+    compactIntoSnapshot();
+    if (journal.file) {
+        syncJournal();
+        fclose(journal.file);
+        journal.file = NULL;
+    }
+}
+
+// ---------------------- 경로 출력 ----------------------
+
+const char* strategyName(int strategy) {
+    switch (strategy) {
+    case SEARCH_FULL_TREE: return "전체 탐색";
+    case SEARCH_EARLY_EXIT: return "도착역 확정 시 종료";
+    case SEARCH_BIDIRECTIONAL: return "양방향";
+    case SEARCH_CH: return "CH";
+    case SEARCH_ALT: return "ALT (A*)";
+    case SEARCH_FARE: return "요금 구간 라벨 탐색";
+    case SEARCH_HUB_TREE: return "허브 트리";
+    }
+    return "알 수 없음";
+}
+
+const char* engineName(int engine) {
+    switch (engine) {
+    case ENGINE_LINEAR: return "선형 탐색";
+    case ENGINE_BINARY_HEAP: return "이진 힙";
+    case ENGINE_RADIX_HEAP: return "radix 힙";
+    }
+    return "알 수 없음";
+}
+
+// 길찾기 프로그램
+// ctx에 담긴 경로를 출발역부터 출력
+void printRoute(SearchContext* ctx, int end) {
+    int* prev = ctx->prev;
+    int* prevLine = ctx->prevLine;
+    printf("경로: ");
+    int* path = ctx->path;
+    int count = 0;
+    for (int v = end; v != -1 && count < stationCount; v = prev[v]) path[count++] = v;
+    int lastLine = prevLine[path[count - 1]];
+    for (int i = count - 1; i >= 0; i--) {
+        int curr = path[i];
+        printf("%s", stations[curr].name);
+        if (i != 0) {
+            int next = path[i - 1];
+            int edgeLine = prevLine[next];
+            if (edgeLine != lastLine) {
+                printf(" (환승: %d호선)", edgeLine);
+                lastLine = edgeLine;
+            }
+            printf(" -> ");
+        }
+    }
+    printf("\n");
+}
+
+RouteStep* routeSteps = NULL;  // findPath가 경로 캐시와 주고받는 경로
+int routeStepCount = 0;
+int routeStepCapacity = 0;
+
+// 노드 u -> v 간선 중 mode 비용이 가장 작은 것 (없으면 -1)
+int cheapestRouteEdge(int u, int v, int mode) {
+    int best = -1;
+    for (int k = routeGraph.offsets[u]; k < routeGraph.offsets[u + 1]; k++)
+        if (routeGraph.target[k] == v && (best == -1 || routeWeight(k, mode) < routeWeight(best, mode))) best = k;
+    return best;
+}
+
+// ctx에 담긴 경로를 역 단위 경로로 옮기고, 노선 그래프 간선을 따라 시간/거리/요금/환승을 다시 더한다
+// (탐색 방식마다 cost에 담긴 값이 달라서, 캐시에는 routeQuery와 같은 기준으로 넣는다)
+void summarizeRoute(SearchContext* ctx, int start, int end, int mode, RouteAnswer* answer) {
+    memset(answer, 0, sizeof(RouteAnswer));
+    int* path = ctx->path;
+    int count = 0;
+    for (int v = end; v != -1 && count < stationCount; v = ctx->prev[v]) path[count++] = v;
+    reserveRouteSteps(&routeSteps, &routeStepCapacity, count);
+    routeStepCount = 0;
+    int meters = 0;
+    for (int i = count - 1; i >= 0; i--) {
+        int s = path[i];
+        RouteStep step = { s, i == count - 1 ? 0 : ctx->prevLine[s], ctx->dist[s] };
+        if (s == start) step.km = 0.0f;
+        routeSteps[routeStepCount++] = step;
+        if (routeStepCount == 1) continue;
+        const RouteStep* last = &routeSteps[routeStepCount - 2];
+        if (routeStepCount > 2 && last->line != step.line) {
+            int k = cheapestRouteEdge(routeNodeOf(last->station, last->line), routeNodeOf(last->station, step.line), mode);
+            if (k != -1) answer->time += routeGraph.weightTime[k];
+            answer->transfers++;
+        }
+        int k = cheapestRouteEdge(routeNodeOf(last->station, step.line), routeNodeOf(s, step.line), mode);
+        if (k == -1) continue;
+        answer->time += routeGraph.weightTime[k];
+        answer->distance += routeGraph.km[k];
+        meters += routeGraph.meters[k];
+    }
+    answer->found = 1;
+    answer->fare = fareForMeters(meters);
 }
-// 요금 계산 함수
-int calculateFare(float distance) {
-    int fare = 1400;
-    if (distance > 10.0f) {
-        int extra = distance - 10.0f;
-        int blocks = (int)((extra + 4.999f) / 5.0f);
-        fare += blocks * 100;
+
+// 경로 캐시에서 꺼낸 경로를 ctx 라벨로 되돌림 (탐색 결과와 똑같이 출력되도록)
+void restoreRoute(SearchContext* ctx, int start, int end, int mode, const RouteAnswer* answer) {
+    beginRouteResult(ctx, start, 0);
+    for (int i = 1; i < routeStepCount; i++) {
+        int s = routeSteps[i].station;
+        touchStation(ctx, s);
+        ctx->prev[s] = routeSteps[i - 1].station;
+        ctx->prevLine[s] = routeSteps[i].line;
+        ctx->dist[s] = routeSteps[i].km;
     }
-    return fare;
+    if (answer->found == 1) ctx->cost[end] = mode == 2 ? answer->distance : answer->time;
 }
-// csv에 간선정보 추가하기
-void appendToCSV(const char* filename, int line, const char* from, const char* to, float distance, float time) {
-    FILE* file = fopen(filename, "a");
-    if (!file) {
-        printf("CSV 파일에 쓰는 데 실패했습니다: %s\n", filename);
+
+void findPath(const char* startName, const char* endName, int mode) {
+    int start = getStationIndexByName(startName);
+    int end = getStationIndexByName(endName);
+    if (start == -1 || end == -1) {
+        printf("입력한 역이 존재하지 않습니다.\n");
         return;
     }
-    fprintf(file, "%d,%s,%s,%.2f,%.2f\n", line, from, to, distance, time);
-    fclose(file);
-}
 
-// ---------------------- CSV 불러오기 ----------------------
-void loadCSV(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        printf("CSV 파일을 열 수 없습니다: %s\n", filename);
+    SearchContext* ctx = &searchContext;
+    int strategy = searchStrategy;
+    int solver = routeSolver(searchStrategy, searchEngine);
+    ensureRouteGraph();  // 편집 후 다시 만드는 시간은 탐색 시간에 넣지 않는다
+
+    // 같은 노선 그래프에서 같은 탐색 방식/엔진으로 같은 질의를 푼 적이 있으면 캐시의 경로를 그대로 출력
+    RouteAnswer answer;
+    clock_t begin = clock();
+    if (routeCacheLookup(start, end, mode, solver, routeGraph.version, routeGraph.metric,
+        &answer, &routeSteps, &routeStepCount, &routeStepCapacity)) {
+        restoreRoute(ctx, start, end, mode, &answer);
+        double elapsedMs = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+        if (answer.found != 1) {
+            printf("경로를 찾을 수 없습니다.\n");
+            return;
+        }
+        printRoute(ctx, end);
+        float totalDist = ctx->dist[end];
+        if (mode == 1)
+            printf("소요 시간: %.1f 분, 거리: %.1f km\n", ctx->cost[end], totalDist);
+        else if (mode == 2)
+            printf("거리: %.1f km\n", totalDist);
+        else if (mode == 3)
+            printf("거리: %.1f km, 총 요금: %d원, 소요 시간: %.1f 분\n", totalDist, calculateFare(totalDist), ctx->cost[end]);
+        printf("탐색 방식: 경로 캐시, 탐색 시간: %.3f ms\n", elapsedMs);
         return;
     }
+    HubTrees* hubs = mode != 3 ? ensureHubTrees() : NULL;  // 트리를 다시 만드는 시간도 탐색 시간에 넣지 않는다
+    int tree = hubTreeOf(hubs, start, mode);
+    if (mode == 3)
+        strategy = SEARCH_FARE;  // 요금은 총 거리로 정해지므로 전용 탐색을 쓴다
+    else if (tree != -1)
+        strategy = SEARCH_HUB_TREE;
+    if (strategy == SEARCH_CH)
+        ensureHierarchy(mode);         // 전처리 시간은 탐색 시간에 넣지 않는다
+    else if (strategy == SEARCH_ALT)
+        ensureLandmarks(mode);
 
-    char buffer[256];
-    fgets(buffer, sizeof(buffer), file);
+    begin = clock();
+    int settledCount;
+    if (strategy == SEARCH_HUB_TREE) {
+        copyHubPath(ctx, hubs, tree, start, end);
+        settledCount = 0;
+    }
+    else if (strategy == SEARCH_FARE) {
+        fareSearch(ctx, start, end);
+        settledCount = ctx->settledCount;
+    }
+    else if (strategy == SEARCH_BIDIRECTIONAL) {
+        bidirectionalSearch(ctx, start, end, mode);
+        settledCount = ctx->settledCount;
+    }
+    else if (strategy == SEARCH_CH) {
+        chSearch(ctx, start, end, mode);
+        settledCount = ctx->settledCount;
+    }
+    else if (strategy == SEARCH_ALT) {
+        altSearch(ctx, start, end, mode);
+        settledCount = ctx->settledCount;
+    }
+    else {
+        ensureRouteGraph();
+        int source = departNode(start), sink = arriveNode(end);
+        shortestPathTree(&routeContext, source, strategy == SEARCH_FULL_TREE ? -1 : sink, mode);
+        copyRoutePath(ctx, &routeContext, start, end, source, sink);
+        settledCount = ctx->settledCount;
+    }
+    double elapsedMs = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+    float* cost = ctx->cost;
+    float* dist = ctx->dist;
 
-    while (fgets(buffer, sizeof(buffer), file)) {
-        char* token = strtok(buffer, ",");
-        if (!token) continue;
-        int line = atoi(token);
+    if (!isReached(ctx, end)) {
+        memset(&answer, 0, sizeof(answer));
+        routeCacheStore(start, end, mode, solver, routeGraph.version, routeGraph.metric, &answer, NULL, 0);
+        printf("경로를 찾을 수 없습니다.\n");
+        return;
+    }
 
-        char* name1 = strtok(NULL, ",");
-        char* name2 = strtok(NULL, ",");
-        char* d_str = strtok(NULL, ",");
-        char* t_str = strtok(NULL, ",");
-        if (!name1 || !name2 || !d_str || !t_str) continue;
+    summarizeRoute(ctx, start, end, mode, &answer);
+    if (mode != 2) answer.time = cost[end];
+    routeCacheStore(start, end, mode, solver, routeGraph.version, routeGraph.metric, &answer, routeSteps, routeStepCount);
 
-        trim(name1); trim(name2);
-        float distance = atof(d_str);
-        float time = atof(t_str);
+    printRoute(ctx, end);
 
-        int fromIndex = getStationIndexByName(name1);
-        if (fromIndex == -1) {
-            memset(&stations[stationCount], 0, sizeof(Station));
-            strncpy(stations[stationCount].name, name1, MAX_STATION_NAME - 1);
-            fromIndex = stationCount++;
-        }
+    float totalDist = dist[end];
+    if (mode == 1)
+        printf("소요 시간: %.1f 분, 거리: %.1f km\n", cost[end], totalDist);
+    else if (mode == 2)
+        printf("거리: %.1f km\n", totalDist);
+    else if (mode == 3)
+        printf("거리: %.1f km, 총 요금: %d원, 소요 시간: %.1f 분\n", totalDist, calculateFare(totalDist), cost[end]);
+    if (strategy == SEARCH_HUB_TREE) {
+        // 트리를 거꾸로 따라가기만 했으므로 큐도 확정한 역도 없다
+        printf("탐색 방식: %s, 탐색 시간: %.3f ms\n", strategyName(strategy), elapsedMs);
+        return;
+    }
+    // 선택한 엔진은 전체 탐색/조기 종료에서만 쓰고, 나머지 방식은 모두 이진 힙을 쓴다
+    int engine = (strategy == SEARCH_FULL_TREE || strategy == SEARCH_EARLY_EXIT) ? searchEngine : ENGINE_BINARY_HEAP;
+    printf("탐색 엔진: %s, 탐색 방식: %s, 확정한 역: %d개, 탐색 시간: %.3f ms\n",
+        engineName(engine), strategyName(strategy), settledCount, elapsedMs);
+}
 
-        int toIndex = getStationIndexByName(name2);
-        if (toIndex == -1) {
-            memset(&stations[stationCount], 0, sizeof(Station));
-            strncpy(stations[stationCount].name, name2, MAX_STATION_NAME - 1);
-            toIndex = stationCount++;
-        }
+// 시간, 환승, 요금이 서로 다른 경로를 한 번에 보여 준다
+void findParetoRoutes(const char* startName, const char* endName) {
+    int start = getStationIndexByName(startName);
+    int end = getStationIndexByName(endName);
+    if (start == -1 || end == -1) {
+        printf("입력한 역이 존재하지 않습니다.\n");
+        return;
+    }
 
-        addEdge(fromIndex, toIndex, time, distance, line);
-        addEdge(toIndex, fromIndex, time, distance, line);
+    ensureRouteGraph();
+    int results[PARETO_MAX_RESULTS];
+    int settledCount;
+    clock_t begin = clock();
+    int found = paretoSearch(start, end, results, PARETO_MAX_RESULTS, &settledCount);
+    double elapsedMs = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+    if (found == 0) {
+        printf("경로를 찾을 수 없습니다.\n");
+        return;
     }
 
-    fclose(file);
-    printf("총 %d개의 역을 불러왔습니다.\n", stationCount);
+    SearchContext* ctx = &searchContext;
+    for (int i = 0; i < found; i++) {
+        int label = results[i];
+        copyParetoPath(ctx, start, end, label, settledCount);
+        printf("\n[%d] 소요 시간: %.1f 분, 환승: %d회, 거리: %.1f km, 요금: %d원\n", i + 1, paretoLabels.time[label],
+            paretoLabels.transfers[label], ctx->dist[end], fareForMeters(paretoLabels.meters[label]));
+        printRoute(ctx, end);
+    }
+    printf("\n탐색 방식: 파레토 라벨 탐색, 확정한 라벨: %d개, 탐색 시간: %.3f ms\n", settledCount, elapsedMs);
 }
 
-// ---------------------- 기능 구현 ----------------------
+// departure(초)에 출발해서 가장 일찍 도착하는 경로를 시간표로 찾는다
+void findTimetableRoute(const char* startName, const char* endName, int departure) {
+    int start = getStationIndexByName(startName);
+    int end = getStationIndexByName(endName);
+    if (start == -1 || end == -1) {
+        printf("입력한 역이 존재하지 않습니다.\n");
+        return;
+    }
 
-// 지하철 전체역 출력
-void printStations() {
-    printf("\n--- 지하철 역 목록 ---\n");
-    for (int i = 0; i < stationCount; i++) {
-        printf("%d - %s\n", i, stations[i].name);
+    ensureTimetable();  // 시간표를 만드는 시간은 탐색 시간에 넣지 않는다
+    RaptorState* rs = &raptorState;
+    clock_t begin = clock();
+    resetRaptorState(rs);
+    int arrival = raptorSearch(rs, start, end, departure);
+    double elapsedMs = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+    if (arrival == NO_TIME) {
+        printf("경로를 찾을 수 없습니다.\n");
+        return;
     }
+
+    RaptorLeg legs[RAPTOR_MAX_ROUNDS];
+    int count = raptorJourney(rs, end, legs, RAPTOR_MAX_ROUNDS);
+    SearchContext* ctx = &searchContext;
+    copyRaptorPath(ctx, start, legs, count);
+    printRoute(ctx, end);
+
+    char from[8], to[8];
+    for (int l = 0; l < count; l++) {
+        const TimetableRoute* route = &timetable.routes[legs[l].route];
+        int boardNode = timetable.routeStops[route->firstStop + legs[l].board];
+        int alightNode = timetable.routeStops[route->firstStop + legs[l].alight];
+        formatClock(legTime(&legs[l], legs[l].board), from, sizeof(from));
+        formatClock(legTime(&legs[l], legs[l].alight), to, sizeof(to));
+        printf("  %d호선 %s %s -> %s %s\n", route->line, from, stations[routeGraph.nodeStation[boardNode]].name,
+            to, stations[routeGraph.nodeStation[alightNode]].name);
+    }
+    formatClock(departure, from, sizeof(from));
+    formatClock(arrival, to, sizeof(to));
+    printf("출발: %s, 도착: %s, 소요 시간: %.1f 분, 환승: %d회, 거리: %.1f km\n", from, to, (arrival - departure) / 60.0f,
+        count > 0 ? count - 1 : 0, ctx->dist[end]);
+    printf("탐색 방식: RAPTOR (시간표 노선 %d개), 탐색 시간: %.3f ms\n", timetable.routeCount, elapsedMs);
 }
 
-// 길찾기 프로그램
-void findPath(const char* startName, const char* endName, int mode) {
+// 출발 시간대 안에서 더 늦게 떠나거나 더 일찍 도착하는 경로를 모두 보여 준다
+void findProfileRoutes(const char* startName, const char* endName, int from, int to) {
     int start = getStationIndexByName(startName);
     int end = getStationIndexByName(endName);
     if (start == -1 || end == -1) {
@@ -164,81 +6360,175 @@ void findPath(const char* startName, const char* endName, int mode) {
         return;
     }
 
-    float cost[MAX_STATIONS];
-    float dist[MAX_STATIONS];
-    int prev[MAX_STATIONS];
-    int visited[MAX_STATIONS] = { 0 };
-    int prevLine[MAX_STATIONS];
+    ensureTimetable();
+    ProfileEntry* entries;
+    int runs;
+    clock_t begin = clock();
+    int found = profileSearch(start, end, from, to, &entries, &runs);
+    double elapsedMs = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+    if (found == 0) printf("시간대 안에 출발하는 경로가 없습니다.\n");
 
-    for (int i = 0; i < stationCount; i++) {
-        cost[i] = INT_MAX;
-        prev[i] = -1;
-        prevLine[i] = 0;
-        dist[i] = 0.0f;
+    char departure[8], arrival[8], board[8];
+    for (int e = 0; e < found; e++) {
+        const ProfileEntry* entry = &entries[e];
+        formatClock(entry->departure, departure, sizeof(departure));
+        formatClock(entry->arrival, arrival, sizeof(arrival));
+        printf("%s 출발 -> %s 도착 (%.1f 분, 환승 %d회):", departure, arrival, (entry->arrival - entry->departure) / 60.0f,
+            entry->legCount > 0 ? entry->legCount - 1 : 0);
+        for (int l = 0; l < entry->legCount; l++) {
+            const TimetableRoute* route = &timetable.routes[entry->legs[l].route];
+            int boardNode = timetable.routeStops[route->firstStop + entry->legs[l].board];
+            formatClock(legTime(&entry->legs[l], entry->legs[l].board), board, sizeof(board));
+            printf("%s %s %d호선", l ? "," : "", board, route->line);
+            if (l) printf(" (%s)", stations[routeGraph.nodeStation[boardNode]].name);
+        }
+        printf("\n");
     }
+    printf("탐색 방식: rRAPTOR, 출발 시각 %d개, 탐색 시간: %.3f ms\n", runs, elapsedMs);
+    free(entries);
+}
 
-    cost[start] = 0;
-
-    for (int i = 0; i < stationCount; i++) {
-        float minCost = INT_MAX;
-        int u = -1;
-        for (int j = 0; j < stationCount; j++) {
-            if (!visited[j] && cost[j] < minCost) {
-                minCost = cost[j];
-                u = j;
-            }
+// 쉼표로 나눈 역 이름 목록을 names에 담는다 (비어 있으면 모든 역). names[i]는 호출한 쪽이 free
+int readStationList(const char* prompt, char*** names) {
+    char text[8192];
+    printf("%s", prompt);
+    if (!fgets(text, sizeof(text), stdin)) text[0] = '\0';
+    trim(text);
+    int count = 0, capacity = 16;
+    *names = (char**)malloc(sizeof(char*) * capacity);
+    if (text[0] == '\0') {
+        *names = (char**)realloc(*names, sizeof(char*) * (stationCount ? stationCount : 1));
+        for (int i = 0; i < stationCount; i++)
+            if (!stations[i].deleted) (*names)[count++] = strdup(stations[i].name);
+        return count;
+    }
+    for (char* token = strtok(text, ","); token; token = strtok(NULL, ",")) {
+        char name[MAX_STATION_NAME];
+        snprintf(name, sizeof(name), "%s", token);
+        trim(name);
+        normalizeInput(name, sizeof(name));
+        if (name[0] == '\0') continue;
+        if (count == capacity) {
+            capacity *= 2;
+            *names = (char**)realloc(*names, sizeof(char*) * capacity);
         }
-        if (u == -1) break;
-        visited[u] = 1;
+        (*names)[count++] = strdup(name);
+    }
+    return count;
+}
 
-        SubwayEdge* e = stations[u].edge;
-        while (e) {
-            int v = e->destIndex;
-            float weight = (mode == 1) ? e->time : (mode == 2) ? e->distance : (float)calculateFare(dist[u] + e->distance);
-            if (prevLine[u] != 0 && prevLine[u] != e->line)
-                weight += TRANSFER_PENALTY;
+// 여러 출발역 x 도착역의 시간/거리/요금을 한 번에 구해서 화면이나 CSV 파일로 내보낸다
+void travelMatrixInteractive() {
+    char** sources;
+    char** targets;
+    int sourceCount = readStationList("출발역 (쉼표로 구분, 비우면 모든 역): ", &sources);
+    int targetCount = readStationList("도착역 (쉼표로 구분, 비우면 모든 역): ", &targets);
+    char filename[1024];
+    printf("저장할 CSV 파일 (비우면 화면에 출력): ");
+    if (!fgets(filename, sizeof(filename), stdin)) filename[0] = '\0';
+    trim(filename);
 
-            if (!visited[v] && cost[u] + weight < cost[v]) {
-                cost[v] = cost[u] + weight;
-                prev[v] = u;
-                prevLine[v] = e->line;
-                dist[v] = dist[u] + e->distance;
-            }
-            e = e->next;
+    TravelMatrix matrix;
+    clock_t begin = clock();
+    int ok = buildTravelMatrix((const char**)sources, sourceCount, (const char**)targets, targetCount, &matrix);
+    double elapsedMs = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+    if (ok) {
+        FILE* out = stdout;
+        if (filename[0]) {
+            out = fopen(filename, "wb");
+            if (!out) printf("파일을 열 수 없습니다: %s\n", filename);
+            else fprintf(out, "\xEF\xBB\xBF출발역,도착역,시간(분),거리(km),요금(원)\n");  // 엑셀에서 UTF-8로 열리도록 BOM
         }
+        for (int i = 0; out && i < sourceCount; i++)
+            for (int j = 0; j < targetCount; j++) {
+                long long cell = (long long)i * targetCount + j;
+                if (out == stdout)
+                    printf("%s -> %s: %.1f 분, %.1f km, %d원\n", sources[i], targets[j], matrix.time[cell], matrix.distance[cell], matrix.fare[cell]);
+                else
+                    fprintf(out, "%s,%s,%.1f,%.1f,%d\n", sources[i], targets[j], matrix.time[cell], matrix.distance[cell], matrix.fare[cell]);
+            }
+        if (out && out != stdout) fclose(out);
+        printf("%d x %d 행렬, 작업 스레드 최대 %d개, 계산 시간: %.3f ms\n", sourceCount, targetCount, processorCount(), elapsedMs);
+        freeTravelMatrix(&matrix);
     }
+    for (int i = 0; i < sourceCount; i++) free(sources[i]);
+    for (int j = 0; j < targetCount; j++) free(targets[j]);
+    free(sources);
+    free(targets);
+}
 
-    if (cost[end] == INT_MAX) {
-        printf("경로를 찾을 수 없습니다.\n");
+// 요청 CSV(출발역,도착역,모드)의 길찾기를 모든 코어로 한꺼번에 돌려서 결과 CSV로 내보낸다
+void batchRoutesInteractive() {
+    char requestFile[1024], resultFile[1024];
+    printf("요청 CSV 파일 (출발역,도착역,모드): ");
+    if (!fgets(requestFile, sizeof(requestFile), stdin)) requestFile[0] = '\0';
+    trim(requestFile);
+    printf("결과 CSV 파일: ");
+    if (!fgets(resultFile, sizeof(resultFile), stdin)) resultFile[0] = '\0';
+    trim(resultFile);
+
+    MappedFile mf;
+    if (!mapFile(&mf, requestFile)) {
+        printf("파일을 열 수 없습니다: %s\n", requestFile);
         return;
     }
+    refreshRoutingSnapshot();
+    RoutingSnapshot* snap = acquireRoutingSnapshot();
 
-    printf("경로: ");
-    int path[MAX_STATIONS], count = 0;
-    for (int v = end; v != -1; v = prev[v]) path[count++] = v;
-    int lastLine = prevLine[path[count - 1]];
-    for (int i = count - 1; i >= 0; i--) {
-        int curr = path[i];
-        printf("%s", stations[curr].name);
-        if (i != 0) {
-            int next = path[i - 1];
-            int edgeLine = prevLine[next];
-            if (edgeLine != lastLine) {
-                printf(" (환승: %d호선)", edgeLine);
-                lastLine = edgeLine;
-            }
-            printf(" -> ");
+    const char* data = mf.data;
+    size_t size = mf.size;
+    int encoding = detectEncoding(&data, &size);
+    CsvScanner sc = { data, data + size };
+    CsvField fields[CSV_MAX_FIELDS];
+    csvReadRow(&sc, fields);  // 머리글
+
+    int count = 0, capacity = 1024, fieldCount;
+    RouteRequest* requests = (RouteRequest*)malloc(sizeof(RouteRequest) * capacity);
+    while ((fieldCount = csvReadRow(&sc, fields)) != -1) {
+        if (fieldCount < 3 || fields[0].length == 0) continue;
+        if (count == capacity) {
+            capacity *= 2;
+            requests = (RouteRequest*)realloc(requests, sizeof(RouteRequest) * capacity);
         }
+        char name[MAX_STATION_NAME * 2];
+        size_t length = transcode(encoding, ENCODING_UTF8, fields[0].text, fields[0].length, name, sizeof(name) - 1);
+        name[length] = '\0';
+        requests[count].start = routingStation(snap, name);
+        length = transcode(encoding, ENCODING_UTF8, fields[1].text, fields[1].length, name, sizeof(name) - 1);
+        name[length] = '\0';
+        requests[count].end = routingStation(snap, name);
+        requests[count].mode = csvInt(&fields[2]);
+        count++;
     }
-    printf("\n");
+    unmapFile(&mf);
 
-    float totalDist = dist[end];
-    if (mode == 1)
-        printf("소요 시간: %.1f 분, 거리: %.1f km\n", cost[end], totalDist);
-    else if (mode == 2)
-        printf("거리: %.1f km\n", totalDist);
-    else if (mode == 3)
-        printf("거리: %.1f km, 총 요금: %d원\n", totalDist, calculateFare(totalDist));
+    RouteAnswer* answers = (RouteAnswer*)malloc(sizeof(RouteAnswer) * (count ? count : 1));
+    clock_t begin = clock();
+    routeBatch(snap, requests, answers, count, 0);
+    double elapsedMs = (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC;
+
+    FILE* out = fopen(resultFile, "wb");
+    if (!out) printf("파일을 열 수 없습니다: %s\n", resultFile);
+    else {
+        fprintf(out, "\xEF\xBB\xBF출발역,도착역,모드,시간(분),거리(km),요금(원),환승\n");
+        for (int i = 0; i < count; i++) {
+            const RouteRequest* r = &requests[i];
+            const RouteAnswer* a = &answers[i];
+            const char* from = r->start >= 0 ? routingStationName(snap, r->start) : "?";
+            const char* to = r->end >= 0 ? routingStationName(snap, r->end) : "?";
+            if (a->found == 1)
+                fprintf(out, "%s,%s,%d,%.1f,%.1f,%d,%d\n", from, to, r->mode, a->time, a->distance, a->fare, a->transfers);
+            else
+                fprintf(out, "%s,%s,%d,%s,,,\n", from, to, r->mode, a->found == 0 ? "경로 없음" : "잘못된 요청");
+        }
+        fclose(out);
+    }
+    int cached = 0;
+    for (int i = 0; i < count; i++) cached += answers[i].cached;
+    printf("요청 %d건 (경로 캐시 %d건), 작업 스레드 최대 %d개, 계산 시간: %.3f ms\n", count, cached, processorCount(), elapsedMs);
+    free(requests);
+    free(answers);
+    releaseRoutingSnapshot(snap);
 }
 
 // 역/호선 추가 함수
@@ -246,30 +6536,24 @@ void addLineInteractive() {
     char from[MAX_STATION_NAME], to[MAX_STATION_NAME];
     float distance, time;
     int line;
-    printf("출발역 이름: "); fgets(from, sizeof(from), stdin); trim(from);
-    printf("도착역 이름: "); fgets(to, sizeof(to), stdin); trim(to);
+    printf("출발역 이름: "); fgets(from, sizeof(from), stdin); trim(from); normalizeInput(from, sizeof(from));
+    printf("도착역 이름: "); fgets(to, sizeof(to), stdin); trim(to); normalizeInput(to, sizeof(to));
     printf("거리 (km): "); scanf("%f", &distance);
     printf("시간 (분): "); scanf("%f", &time);
     printf("호선 번호: "); scanf("%d", &line);
     while (getchar() != '\n');
-
-    int fromIdx = getStationIndexByName(from);
-    if (fromIdx == -1) {
-        memset(&stations[stationCount], 0, sizeof(Station));
-        strncpy(stations[stationCount].name, from, MAX_STATION_NAME - 1);
-        fromIdx = stationCount++;
+    if (!isStorableName(from) || !isStorableName(to)) {
+        printf("역 이름은 비어 있거나 ','를 포함할 수 없습니다.\n");
+        return;
     }
 
-    int toIdx = getStationIndexByName(to);
-    if (toIdx == -1) {
-        memset(&stations[stationCount], 0, sizeof(Station));
-        strncpy(stations[stationCount].name, to, MAX_STATION_NAME - 1);
-        toIdx = stationCount++;
-    }
+    int fromIdx = getOrAddStation(from);
+    int toIdx = getOrAddStation(to);
 
     addEdge(fromIdx, toIdx, time, distance, line);
     addEdge(toIdx, fromIdx, time, distance, line);
-    appendToCSV("subway_line.csv", line, from, to, distance, time);
+    journalAddEdge(line, from, to, distance, time);
+    landmarksStale = 1;  // 새 간선으로 거리가 줄어들 수 있음
     printf("호선이 추가되었습니다.\n");
 }
 
@@ -284,73 +6568,214 @@ void deleteLineInteractive() {
     }
     while (getchar() != '\n');
 
-    int deletedCount = 0;
+    // 메모리에서 간선 제거. 노선도 파일은 그대로 두고 변경 기록에만 남긴다
+    int deletedCount = deleteLineEdges(targetLine);
+    if (deletedCount > 0) {
+        journalDeleteLine(targetLine);
+        printf("%d호선의 간선 %d개가 제거되었습니다.\n", targetLine, deletedCount);
+    }
+    else {
+        printf("해당 호선은 존재하지 않거나 연결된 간선이 없습니다.\n");
+    }
+}
 
-    // 메모리에서 간선 제거
-    for (int i = 0; i < stationCount; i++) {
-        SubwayEdge** edgePtr = &stations[i].edge;
-        while (*edgePtr) {
-            if ((*edgePtr)->line == targetLine) {
-                SubwayEdge* temp = *edgePtr;
-                *edgePtr = (*edgePtr)->next;
-                free(temp);
-                deletedCount++;
-            }
-            else {
-                edgePtr = &(*edgePtr)->next;
-            }
-        }
+// 호선 운행 중지/재개 (공사 등으로 잠시 닫을 때). 간선은 남겨 두므로 다시 열면 그대로 돌아온다
+void suspendLineInteractive() {
+    int line, action;
+    printf("호선 번호: ");
+    if (scanf("%d", &line) != 1) {
+        printf("잘못된 입력입니다.\n");
+        while (getchar() != '\n');
+        return;
+    }
+    printf("1. 운행 중지\n2. 운행 재개\n선택: ");
+    if (scanf("%d", &action) != 1 || action < 1 || action > 2) {
+        printf("잘못된 입력입니다.\n");
+        while (getchar() != '\n');
+        return;
+    }
+    while (getchar() != '\n');
+
+    int suspended = action == 1;
+    LineEntry* entry = findLineEntry(line, 0);
+    int changed = entry && entry->suspended != suspended;
+    if (setLineSuspended(line, suspended) == 0) {
+        printf("해당 호선은 존재하지 않거나 연결된 간선이 없습니다.\n");
+        return;
+    }
+    if (changed) journalSuspendLine(line, suspended);
+    printf(suspended ? "%d호선 운행을 중지했습니다.\n" : "%d호선 운행을 재개했습니다.\n", line);
+}
+
+// 호선의 역을 종점부터 순서대로 출력
+void listLineStationsInteractive() {
+    int line;
+    printf("호선 번호: ");
+    if (scanf("%d", &line) != 1) {
+        printf("잘못된 입력입니다.\n");
+        while (getchar() != '\n');
+        return;
     }
+    while (getchar() != '\n');
+
+    int count;
+    const int* segmentFrom;
+    const int* sequence = lineStations(line, &count, &segmentFrom);
+    if (!sequence) {
+        printf("해당 호선은 존재하지 않거나 연결된 간선이 없습니다.\n");
+        return;
+    }
+    printf("\n--- %d호선 역 목록 (%d개%s) ---\n", line, count, lineSuspended(line) ? ", 운행 중지" : "");
+    // 이어지지 않는 구간은 줄을 바꿔서 따로 보여 준다 (갈래는 갈라지는 역부터)
+    for (int i = 0; i < count; i++) {
+        if (segmentFrom[i] == -2) printf(" -> ");
+        else if (i) printf("\n");
+        if (segmentFrom[i] >= 0) printf("%s -> ", stations[segmentFrom[i]].name);
+        printf("%s", stations[sequence[i]].name);
+    }
+    printf("\n");
+}
 
-    // CSV에서 해당 호선 제거
-    FILE* original = fopen("subway_line.csv", "r");
-    FILE* temp = fopen("temp.csv", "w");
-    if (!original || !temp) {
-        printf("파일 처리 오류.\n");
-        if (original) fclose(original);
-        if (temp) fclose(temp);
+// 구간 통제 (장애로 운행 중단, 서행). 노선도 파일과 변경 기록에는 남기지 않고 이번 실행 동안만 적용한다
+void disruptionInteractive() {
+    int action, line;
+    printf("1. 구간 운행 중단\n2. 구간 서행 (시간 배수)\n3. 구간 통제 해제\n4. 통제 목록\n선택: ");
+    if (scanf("%d", &action) != 1 || action < 1 || action > 4) {
+        printf("잘못된 입력입니다.\n");
+        while (getchar() != '\n');
         return;
     }
+    while (getchar() != '\n');
 
-    char buffer[256];
-    // 헤더 복사
-    if (fgets(buffer, sizeof(buffer), original)) {
-        fputs(buffer, temp);
+    if (action == 4) {
+        if (disruptionCount == 0) printf("통제 중인 구간이 없습니다.\n");
+        for (int i = 0; i < disruptionCount; i++) {
+            const Disruption* d = &disruptions[i];
+            printf("%d호선 %s - %s: ", d->line, stations[d->from].name, stations[d->to].name);
+            if (d->closed) printf("운행 중단\n");
+            else printf("시간 x%.2f\n", d->factor);
+        }
+        return;
     }
 
-    while (fgets(buffer, sizeof(buffer), original)) {
-        int line;
-        char tempBuf[256];
-        strncpy(tempBuf, buffer, sizeof(tempBuf));
-        char* token = strtok(tempBuf, ",");
-        if (!token) continue;
-        line = atoi(token);
-        if (line != targetLine) {
-            fputs(buffer, temp);  // 다른 호선만 복사
+    char from[MAX_STATION_NAME], to[MAX_STATION_NAME];
+    float factor = 1.0f;
+    printf("호선 번호: ");
+    if (scanf("%d", &line) != 1) {
+        printf("잘못된 입력입니다.\n");
+        while (getchar() != '\n');
+        return;
+    }
+    while (getchar() != '\n');
+    printf("구간 시작역: "); fgets(from, sizeof(from), stdin); trim(from); normalizeInput(from, sizeof(from));
+    printf("구간 끝역: "); fgets(to, sizeof(to), stdin); trim(to); normalizeInput(to, sizeof(to));
+    if (action == 2) {
+        printf("시간 배수 (예: 2): ");
+        if (scanf("%f", &factor) != 1 || factor <= 0.0f) {
+            printf("잘못된 입력입니다.\n");
+            while (getchar() != '\n');
+            return;
         }
+        while (getchar() != '\n');
     }
 
-    fclose(original);
-    fclose(temp);
+    int fromIdx = getStationIndexByName(from);
+    int toIdx = getStationIndexByName(to);
+    if (fromIdx == -1 || toIdx == -1) {
+        printf("역을 찾을 수 없습니다.\n");
+        return;
+    }
+    if (action == 3) {
+        if (clearDisruption(fromIdx, toIdx, line)) printf("%d호선 %s - %s 구간 통제를 해제했습니다.\n", line, from, to);
+        else printf("통제 중인 구간이 아닙니다.\n");
+        return;
+    }
+    if (!setDisruption(fromIdx, toIdx, line, action == 1, factor)) {
+        printf("%d호선에 %s - %s 구간이 없습니다.\n", line, from, to);
+        return;
+    }
+    if (action == 1) printf("%d호선 %s - %s 구간 운행을 중단했습니다.\n", line, from, to);
+    else printf("%d호선 %s - %s 구간 시간을 %.2f배로 바꿨습니다.\n", line, from, to, factor);
+}
 
-    // 원본 파일 덮어쓰기
-    remove("subway_line.csv");
-    rename("temp.csv", "subway_line.csv");
+// 경로 캐시 통계 / 켜기·끄기 / 비우기 (엔진이나 탐색 방식을 비교할 때는 끄고 쓴다)
+void routeCacheInteractive() {
+    int current;
+    long lookups, hits, evictions;
+    ensureRouteGraph();
+    routeCacheStats(routeGraph.version, routeGraph.metric, &current, &lookups, &hits, &evictions);
+    printf("경로 캐시: %s, 항목 %d / %d개, 조회 %ld회, 적중 %ld회 (%.1f%%), 교체 %ld회\n",
+        routeCacheEnabled ? "사용" : "사용 안 함", current, ROUTE_CACHE_SETS * ROUTE_CACHE_WAYS,
+        lookups, hits, lookups ? hits * 100.0 / lookups : 0.0, evictions);
 
-    if (deletedCount > 0) {
-        printf("%d호선의 간선 %d개가 제거되었습니다.\n", targetLine, deletedCount);
+    int action;
+    printf("1. 켜기/끄기\n2. 비우기\n0. 돌아가기\n선택: ");
+    if (scanf("%d", &action) != 1 || action < 0 || action > 2) {
+        printf("잘못된 입력입니다.\n");
+        while (getchar() != '\n');
+        return;
+    }
+    while (getchar() != '\n');
+    if (action == 1) {
+        routeCacheEnabled = !routeCacheEnabled;
+        printf("경로 캐시를 %s.\n", routeCacheEnabled ? "켰습니다" : "껐습니다");
+    }
+    else if (action == 2) {
+        clearRouteCache();
+        printf("경로 캐시를 비웠습니다.\n");
     }
+}
+
+// 허브 역 보기 / 이름으로 정하기 / 자동 / 켜기·끄기
+void hubTreesInteractive() {
+    HubTrees* trees = ensureHubTrees();
+    if (!trees) printf("허브 최단 경로 트리: 사용 안 함\n");
     else {
-        printf("해당 호선은 존재하지 않거나 연결된 간선이 없습니다.\n");
+        printf("허브 역 (%s): ", hubNameCount > 0 ? "지정" : "자동");
+        for (int h = 0; h < trees->hubCount; h++) printf("%s%s", h ? ", " : "", stations[trees->hubs[h]].name);
+        double megabytes = (double)trees->hubCount * 2 * trees->nodeCount * (2 * sizeof(float) + 2 * sizeof(int)) / (1024.0 * 1024.0);
+        printf("\n트리 %d개, 노드 %d개씩, %.1f MB, 만든 시간: %.1f ms\n", trees->hubCount * 2, trees->nodeCount, megabytes, trees->buildMs);
+    }
+
+    int action;
+    printf("1. 허브 역 지정 (쉼표로 구분)\n2. 자동으로 고르기\n3. 켜기/끄기\n0. 돌아가기\n선택: ");
+    if (scanf("%d", &action) != 1 || action < 0 || action > 3) {
+        printf("잘못된 입력입니다.\n");
+        while (getchar() != '\n');
+        return;
+    }
+    while (getchar() != '\n');
+    if (action == 1) {
+        char line[1024];
+        printf("허브 역 이름: "); fgets(line, sizeof(line), stdin);
+        hubNameCount = 0;
+        for (char* name = strtok(line, ",\r\n"); name && hubNameCount < HUB_MAX; name = strtok(NULL, ",\r\n")) {
+            strncpy(hubNames[hubNameCount], name, MAX_STATION_NAME - 1);
+            hubNames[hubNameCount][MAX_STATION_NAME - 1] = '\0';
+            trim(hubNames[hubNameCount]);
+            normalizeInput(hubNames[hubNameCount], MAX_STATION_NAME);
+            if (getStationIndexByName(hubNames[hubNameCount]) == -1) printf("역을 찾을 수 없습니다: %s\n", hubNames[hubNameCount]);
+            else hubNameCount++;
+        }
     }
+    else if (action == 2) hubNameCount = 0;
+    else if (action == 3) hubTreesEnabled = !hubTreesEnabled;
+    if (action == 0) return;
+
+    dropHubTrees();
+    trees = ensureHubTrees();
+    if (trees) printf("허브 %d곳의 트리를 만들었습니다 (%.1f ms).\n", trees->hubCount, trees->buildMs);
+    else printf("허브 최단 경로 트리를 껐습니다.\n");
 }
 
 // 역 삭제
 void deleteStationInteractive() {
+    ensureEdgeLists();
     char name[MAX_STATION_NAME];
     printf("삭제할 역 이름: ");
     fgets(name, sizeof(name), stdin);
     trim(name);
+    normalizeInput(name, sizeof(name));
 
     int target = getStationIndexByName(name);
     if (target == -1) {
@@ -385,103 +6810,74 @@ void deleteStationInteractive() {
         if (lines[0] == lines[1]) {
             addEdge(a, c, totalTime, totalDist, lines[0]);
             addEdge(c, a, totalTime, totalDist, lines[0]);
-            appendToCSV("subway_line.csv", lines[0], stations[a].name, stations[c].name, totalDist, totalTime);
+            journalAddEdge(lines[0], stations[a].name, stations[c].name, totalDist, totalTime);
             printf("'%s' 삭제로 인해 '%s' ↔ '%s' 간선이 자동 추가되었습니다 (%.1fkm, %.1f분).\n",
                 stations[target].name, stations[a].name, stations[c].name, totalDist, totalTime);
         }
     }
 
-    // 1. 메모리에서 삭제 작업
-    for (int i = 0; i < stationCount; i++) {
-        if (i == target) continue;
-        SubwayEdge** edgePtr = &stations[i].edge;
-        while (*edgePtr) {
-            if ((*edgePtr)->destIndex == target) {
-                SubwayEdge* temp = *edgePtr;
-                *edgePtr = (*edgePtr)->next;
-                free(temp);
-            }
-            else {
-                if ((*edgePtr)->destIndex > target) {
-                    (*edgePtr)->destIndex--;
-                }
-                edgePtr = &(*edgePtr)->next;
-            }
-        }
-    }
-
-    SubwayEdge* edge = stations[target].edge;
-    while (edge) {
-        SubwayEdge* temp = edge;
-        edge = edge->next;
-        free(temp);
-    }
+    // 메모리에서 삭제하고 변경 기록에 남김
+    removeStation(target);
+    journalDeleteStation(name);
 
-    for (int i = target; i < stationCount - 1; i++) {
-        stations[i] = stations[i + 1];
-    }
-    stationCount--;
+    printf("역 '%s' 삭제되었습니다.\n", name);
+}
 
-    // 2. CSV에서 삭제
-    FILE* original = fopen("subway_line.csv", "r");
-    FILE* temp = fopen("temp.csv", "w");
-    if (!original || !temp) {
-        printf("CSV 파일 열기 실패\n");
-        if (original) fclose(original);
-        if (temp) fclose(temp);
+// 탐색 엔진 선택 (같은 질의를 엔진별로 비교할 때 사용)
+void selectEngineInteractive() {
+    int engine;
+    printf("현재 엔진: %s\n", engineName(searchEngine));
+    printf("0. 선형 탐색\n1. 이진 힙\n2. radix 힙\n선택: ");
+    if (scanf("%d", &engine) != 1 || engine < ENGINE_LINEAR || engine > ENGINE_RADIX_HEAP) {
+        printf("잘못된 입력입니다.\n");
+        while (getchar() != '\n');
         return;
     }
+    while (getchar() != '\n');
+    searchEngine = engine;
+    printf("탐색 엔진이 '%s'(으)로 변경되었습니다.\n", engineName(searchEngine));
+}
 
-    char buffer[512];
-    int deletedCSV = 0;
-    int isFirstLine = 1;
-
-    while (fgets(buffer, sizeof(buffer), original)) {
-        if (isFirstLine) {
-            fputs(buffer, temp);
-            isFirstLine = 0;
-            continue;
-        }
-
-        char bufCopy[512];
-        strncpy(bufCopy, buffer, sizeof(bufCopy));
-        bufCopy[sizeof(bufCopy) - 1] = '\0';
-
-        char* token = strtok(bufCopy, ","); // 호선
-        if (!token) continue;
-
-        token = strtok(NULL, ","); // 출발역
-        if (!token) continue;
-        char from[MAX_STATION_NAME];
-        strncpy(from, token, MAX_STATION_NAME); trim(from);
-
-        token = strtok(NULL, ","); // 도착역
-        if (!token) continue;
-        char to[MAX_STATION_NAME];
-        strncpy(to, token, MAX_STATION_NAME); trim(to);
-
-        if (strcmp(from, name) == 0 || strcmp(to, name) == 0) {
-            deletedCSV++;
-            continue;
-        }
-
-        fputs(buffer, temp);
+// 탐색 방식 선택
+void selectStrategyInteractive() {
+    int strategy;
+    printf("현재 탐색 방식: %s\n", strategyName(searchStrategy));
+    printf("0. 전체 탐색\n1. 도착역 확정 시 종료\n2. 양방향\n3. CH (첫 질의 때 전처리, 파일로 저장)\n4. ALT (랜드마크 A*)\n");
+    printf("(최소 요금 경로는 항상 요금 구간 라벨 탐색)\n선택: ");
+    if (scanf("%d", &strategy) != 1 || strategy < SEARCH_FULL_TREE || strategy > SEARCH_ALT) {
+        printf("잘못된 입력입니다.\n");
+        while (getchar() != '\n');
+        return;
     }
-
-    fclose(original);
-    fclose(temp);
-    remove("subway_line.csv");
-    rename("temp.csv", "subway_line.csv");
-
-    printf("역 '%s' 삭제되었습니다.\n", name, deletedCSV);
+    while (getchar() != '\n');
+    searchStrategy = strategy;
+    printf("탐색 방식이 '%s'(으)로 변경되었습니다.\n", strategyName(searchStrategy));
 }
 
-
-
 // ---------------------- 메인 함수 ----------------------
 
-int main() {
+int main(int argc, char** argv) {
     int choice;
+#ifdef _WIN32
+    // 역 이름과 메시지를 모두 UTF-8로 주고받는다 (프로젝트는 /utf-8로 빌드)
+    SetConsoleCP(CP_UTF8);
+    SetConsoleOutputCP(CP_UTF8);
+#endif
+    // 실행 인자로 노선도 파일, 디렉터리 또는 목록 파일을 줄 수 있다 (기본: subway_line.csv)
+    const char* networkPath = argc > 1 ? argv[1] : "subway_line.csv";
+    char snapshotPath[1024];
+    snprintf(snapshotPath, sizeof(snapshotPath), "%s.snap", networkPath);
+    snprintf(hierarchyNetworkPath, sizeof(hierarchyNetworkPath), "%s", networkPath);
+
+    // 노선도 파일이 그대로면 지난번 스냅샷으로 바로 시작
+    clock_t begin = clock();
+    if (loadSnapshot(snapshotPath, networkPath))
+        printf("스냅샷에서 %d개의 역을 불러왔습니다 (%.1f ms).\n", stationCount, (double)(clock() - begin) * 1000.0 / CLOCKS_PER_SEC);
+    // 스냅샷을 못 쓰더라도 변경 기록이 있으면 노선도를 읽고 그 위에 다시 적용한다
+    openJournal(networkPath, snapshotPath);
+    if (stationCount == 0 && journalHasRecords()) loadNetwork(networkPath);
+    if (stationCount > 0) replayJournal();
+    if (stationCount > 0) ensureHubTrees();  // 허브 트리는 불러올 때 모든 코어로 미리 만든다
 
     while (1) {
         system("cls");
@@ -492,6 +6888,15 @@ int main() {
         printf("4. 역/호선 추가(기존역 가능, 새로운 역 만들기 가능)\n");
         printf("5. 호선 삭제\n");
         printf("6. 역 삭제\n");
+        printf("7. 탐색 엔진 선택\n");
+        printf("8. 탐색 방식 선택\n");
+        printf("9. 여러 역 사이 시간/거리/요금 표\n");
+        printf("10. 일괄 길찾기 (요청 CSV -> 결과 CSV)\n");
+        printf("11. 호선 운행 중지/재개\n");
+        printf("12. 호선별 역 목록\n");
+        printf("13. 구간 통제 (운행 중단 / 서행)\n");
+        printf("14. 경로 캐시 통계\n");
+        printf("15. 허브 역 최단 경로 트리\n");
         printf("0. 프로그램 종료\n");
         printf("\n메뉴 선택 : ");
         if (scanf("%d", &choice) != 1) {
@@ -502,7 +6907,15 @@ int main() {
 
         switch (choice) {
         case 1:
-            loadCSV("subway_line.csv");
+            finishCompaction(1);  // 노선도 파일을 새로 쓰는 중이면 끝날 때까지 기다림
+            // 변경 기록을 스냅샷으로 압축해 두었으면 그 기록은 스냅샷에만 있으므로 스냅샷부터 읽는다
+            if (!journalMerged || !loadSnapshot(snapshotPath, networkPath)) {
+                loadNetwork(networkPath);
+                journalMerged = 0;
+            }
+            if (stationCount > 0) replayJournal();
+            if (stationCount > 0) saveSnapshot(snapshotPath, networkPath);
+            if (stationCount > 0) ensureHubTrees();
             break;
         case 2:
             printStations();
@@ -520,16 +6933,42 @@ int main() {
 
             char start[MAX_STATION_NAME], end[MAX_STATION_NAME];
             int mode;
-            printf("출발역 이름: "); fgets(start, sizeof(start), stdin); trim(start);
-            printf("도착역 이름: "); fgets(end, sizeof(end), stdin); trim(end);
-            printf("1. 최소 시간 경로\n2. 최단 거리 경로\n3. 최소 요금 경로\n선택: ");
-            if (scanf("%d", &mode) != 1 || mode < 1 || mode > 3) {
+            printf("출발역 이름: "); fgets(start, sizeof(start), stdin); trim(start); normalizeInput(start, sizeof(start));
+            printf("도착역 이름: "); fgets(end, sizeof(end), stdin); trim(end); normalizeInput(end, sizeof(end));
+            printf("1. 최소 시간 경로\n2. 최단 거리 경로\n3. 최소 요금 경로\n4. 시간/환승/요금 비교\n5. 출발 시각 기준 (시간표)\n6. 출발 시간대 기준 (시간표)\n선택: ");
+            if (scanf("%d", &mode) != 1 || mode < 1 || mode > 6) {
                 printf("잘못된 입력입니다.\n");
                 while (getchar() != '\n');
                 break;
             }
             while (getchar() != '\n');
-            findPath(start, end, mode);
+            if (mode == 5) {
+                char text[32];
+                printf("출발 시각 (HH:MM, 비우면 지금): "); fgets(text, sizeof(text), stdin); trim(text);
+                int departure = text[0] ? parseClock(text) : local->tm_hour * 3600 + local->tm_min * 60 + local->tm_sec;
+                if (departure < 0) {
+                    printf("잘못된 입력입니다.\n");
+                    break;
+                }
+                if (departure < SERVICE_DAY_START) departure += 24 * 3600;
+                findTimetableRoute(start, end, departure);
+            }
+            else if (mode == 6) {
+                char text[32];
+                printf("시간대 시작 (HH:MM): "); fgets(text, sizeof(text), stdin); trim(text);
+                int from = parseClock(text);
+                printf("시간대 끝 (HH:MM): "); fgets(text, sizeof(text), stdin); trim(text);
+                int to = parseClock(text);
+                if (from < 0 || to < 0) {
+                    printf("잘못된 입력입니다.\n");
+                    break;
+                }
+                if (from < SERVICE_DAY_START) from += 24 * 3600;
+                if (to < from) to += 24 * 3600;
+                findProfileRoutes(start, end, from, to);
+            }
+            else if (mode == 4) findParetoRoutes(start, end);
+            else findPath(start, end, mode);
             break;
         }
         case 4:
@@ -541,12 +6980,43 @@ int main() {
         case 6:
             deleteStationInteractive();
             break;
+        case 7:
+            selectEngineInteractive();
+            break;
+        case 8:
+            selectStrategyInteractive();
+            break;
+        case 9:
+            travelMatrixInteractive();
+            break;
+        case 10:
+            batchRoutesInteractive();
+            break;
+        case 11:
+            suspendLineInteractive();
+            break;
+        case 12:
+            listLineStationsInteractive();
+            break;
+        case 13:
+            disruptionInteractive();
+            break;
+        case 14:
+            routeCacheInteractive();
+            break;
+        case 15:
+            hubTreesInteractive();
+            break;
 
         case 0:
+            closeJournal();
+            updateSnapshot(snapshotPath, networkPath);
             exit(0);
         default:
             printf("잘못된 선택입니다.\n");
         }
+        syncJournal();  // 이번 메뉴에서 쌓인 기록은 입력을 기다리기 전에 디스크에
+        if (journal.size >= JOURNAL_COMPACT_BYTES) compactIntoSnapshot();  // 디렉터리/목록 파일 노선도
 
         printf("\n\n\t\t");
         system("pause");